@@ -0,0 +1,94 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+volatile int done = 0;
+
+int deep (int depth)
+{
+  volatile char frame[1024];
+  memset ((char *) frame, depth, sizeof (frame));
+  if (depth == 0)
+  {
+    return frame[0];
+  }
+  return deep (depth - 1) + frame[1];
+}
+
+void big_stack ()
+{
+  deep (512); // about 512KB of stack
+  done = 1;
+  uthread_terminate (uthread_get_tid ());
+}
+
+void overflow ()
+{
+  deep (1024); // much more than the default stack
+  uthread_terminate (uthread_get_tid ());
+}
+
+int main(int argc, char **argv)
+{
+  // a child that overflows a default stack must crash on the guard page
+  pid_t pid = fork ();
+  if (pid == 0)
+  {
+    uthread_init (999999);
+    uthread_spawn (overflow);
+    kill (getpid (), SIGVTALRM);
+    exit (0);
+  }
+  int status;
+  waitpid (pid, &status, 0);
+  if (!WIFSIGNALED (status) || WTERMSIG (status) != SIGSEGV)
+  {
+    printf ("Test failed: stack overflow didn't hit the guard page\n");
+    exit (1);
+  }
+
+  uthread_init (999999);
+  uthread_attr_t attr;
+  uthread_attr_init (&attr);
+  attr.stack_size = 1024 * 1024;
+  uthread_spawn_ex (big_stack, &attr);
+  kill (getpid (), SIGVTALRM);
+  if (!done)
+  {
+    printf ("Test failed: thread with a big stack didn't finish\n");
+    exit (1);
+  }
+  done = 0;
+  attr.stack_size = 64 * 1024 * 1024;
+  attr.stack_mode = UTHREAD_STACK_LAZY;
+  uthread_spawn_ex (big_stack, &attr);
+  kill (getpid (), SIGVTALRM);
+  if (!done)
+  {
+    printf ("Test failed: thread with a lazy stack didn't finish\n");
+    exit (1);
+  }
+  attr.stack_size = 0;
+  if (uthread_spawn_ex (big_stack, &attr) != -1)
+  {
+    printf ("Test failed: zero stack_size was accepted\n");
+    exit (1);
+  }
+  attr.stack_size = (size_t) -1;
+  if (uthread_spawn_ex (big_stack, &attr) != -1)
+  {
+    printf ("Test failed: a stack_size beyond the largest stack was accepted\n");
+    exit (1);
+  }
+  if (uthread_attr_init (NULL) != -1)
+  {
+    printf ("Test failed: a null attr was accepted\n");
+    exit (1);
+  }
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
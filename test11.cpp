@@ -0,0 +1,51 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define NUM_THREADS 5000
+
+volatile int ran = 0;
+
+void f()
+{
+  ran++;
+  uthread_terminate (uthread_get_tid ());
+}
+
+int main(int argc, char **argv)
+{
+  if (uthread_init_ex (999999, 0) != -1)
+  {
+    printf ("Test failed: max_thread_num 0 was accepted\n");
+    exit (1);
+  }
+  uthread_init_ex (999999, NUM_THREADS);
+  for (int i = 1; i < NUM_THREADS; i++)
+  {
+    if (uthread_spawn (f) != i)
+    {
+      printf ("Test failed: spawn of thread %d\n", i);
+      exit (1);
+    }
+  }
+  if (uthread_spawn (f) != -1)
+  {
+    printf ("Test failed: spawn over max_thread_num\n");
+    exit (1);
+  }
+  if (uthread_get_quantums (NUM_THREADS - 1) != 0 || uthread_get_quantums (NUM_THREADS) != -1)
+  {
+    printf ("Test failed: uthread_get_quantums\n");
+    exit (1);
+  }
+  kill (getpid (), SIGVTALRM); // every thread runs once and terminates
+  if (ran != NUM_THREADS - 1)
+  {
+    printf ("Test failed: only %d threads ran\n", ran);
+    exit (1);
+  }
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
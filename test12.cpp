@@ -0,0 +1,69 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+int order[16];
+int order_len = 0;
+
+void record ()
+{
+  order[order_len++] = uthread_get_tid ();
+}
+
+void f()
+{
+  while (true)
+  {
+    record ();
+    uthread_yield ();
+  }
+}
+
+void g()
+{
+  while (true)
+  {
+    record ();
+    uthread_switch_to (0); // straight back to main, ahead of thread 1
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (999999);
+  uthread_spawn (f);
+  uthread_spawn (g);
+  int quantums = uthread_get_total_quantums ();
+  uthread_yield ();               // 1 runs, then 2, which switches straight back to 0
+  uthread_switch_to (2);          // 2 runs before 1, and switches straight back to 0
+  uthread_yield ();               // 1 runs, then 2, back to 0
+  int expected[] = {1, 2, 2, 1, 2};
+  int expected_len = sizeof (expected) / sizeof (expected[0]);
+  bool ok = order_len == expected_len;
+  for (int i = 0; ok && i < expected_len; i++)
+  {
+    ok = order[i] == expected[i];
+  }
+  if (!ok)
+  {
+    printf ("Test failed: wrong order:");
+    for (int i = 0; i < order_len; i++)
+    {
+      printf (" %d", order[i]);
+    }
+    printf ("\n");
+    exit (1);
+  }
+  if (uthread_get_total_quantums () != quantums + 8)
+  {
+    printf ("Test failed: %d quantums instead of %d\n", uthread_get_total_quantums () - quantums, 8);
+    exit (1);
+  }
+  if (uthread_switch_to (5) != -1 || uthread_switch_to (0) != 0)
+  {
+    printf ("Test failed: uthread_switch_to return value\n");
+    exit (1);
+  }
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
@@ -0,0 +1,72 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+int a_runs = 0;
+int b_runs = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void a()
+{
+  a_runs++;
+  uthread_set_priority (uthread_get_tid (), 10); // below main, so main runs right away
+  while (true)
+  {
+    a_runs++;
+    if (a_runs == 5)
+    {
+      uthread_set_priority (0, 20); // main preempts this thread right away
+    }
+    uthread_yield ();
+  }
+}
+
+void b()
+{
+  while (true)
+  {
+    b_runs++;
+    uthread_yield ();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (999999);
+  if (uthread_set_sched_policy (42) != -1 || uthread_set_sched_policy (UTHREAD_SCHED_PRIORITY) != 0)
+    fail ("uthread_set_sched_policy return value");
+
+  uthread_attr_t attr;
+  uthread_attr_init (&attr);
+  attr.priority = 20;
+  int tid_a = uthread_spawn_ex (a, &attr); // higher than main, runs before uthread_spawn_ex returns
+  if (a_runs != 1 || uthread_get_priority (tid_a) != 10)
+    fail ("the higher priority thread did not run first");
+
+  attr.priority = 10;
+  uthread_spawn_ex (b, &attr);
+  uthread_yield (); // main is the only one of the highest priority, so it keeps running
+  if (a_runs != 1 || b_runs != 0)
+    fail ("a lower priority thread ran");
+
+  uthread_set_priority (0, 5); // a and b share the CPU until a raises main back
+  if (a_runs != 5 || b_runs != 3 || uthread_get_priority (0) != 20)
+    fail ("wrong round-robin between the threads of the same priority");
+
+  attr.priority = UTHREAD_PRIORITY_LEVELS;
+  if (uthread_spawn_ex (b, &attr) != -1 || uthread_set_priority (tid_a, -1) != -1 || uthread_get_priority (7) != -1)
+    fail ("priority out of range");
+
+  if (uthread_set_sched_policy (UTHREAD_SCHED_RR) != 0)
+    fail ("uthread_set_sched_policy return value");
+  uthread_yield (); // everyone runs round-robin again (a continues from where main preempted it)
+  if (a_runs != 5 || b_runs != 4)
+    fail ("round-robin after changing the policy back");
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
@@ -0,0 +1,75 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+volatile long hog_spins = 0;
+int io_runs = 0;
+int io_max_level = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void hog()
+{
+  while (true)
+  {
+    hog_spins++;
+  }
+}
+
+void io()
+{
+  while (true)
+  {
+    io_runs++;
+    int level = uthread_get_mlfq_level (uthread_get_tid ());
+    if (level > io_max_level)
+    {
+      io_max_level = level;
+    }
+    uthread_sleep (3);
+  }
+}
+
+void yielder()
+{
+  while (true)
+  {
+    uthread_yield ();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (500);
+  if (uthread_set_sched_policy (UTHREAD_SCHED_MLFQ) != 0)
+    fail ("uthread_set_sched_policy return value");
+  int tid_hog = uthread_spawn (hog);
+  int tid_io = uthread_spawn (io);
+  if (uthread_get_mlfq_level (tid_hog) != 0 || uthread_get_mlfq_level (42) != -1)
+    fail ("uthread_get_mlfq_level return value");
+
+  // the hog uses all of its quanta and sinks to the bottom level, the thread that sleeps right away stays on top
+  while (uthread_get_mlfq_level (tid_hog) != UTHREAD_MLFQ_LEVELS - 1)
+  {
+  }
+  if (io_runs == 0 || io_max_level != 0 || uthread_get_mlfq_level (tid_io) != 0)
+    fail ("the sleeping thread moved down");
+
+  // main and the yielder always have a READY thread on the top level, only the boost lets the hog run
+  uthread_spawn (yielder);
+  uthread_yield ();
+  long spins = hog_spins;
+  int start = uthread_get_total_quantums ();
+  while (hog_spins == spins)
+  {
+    uthread_yield ();
+  }
+  if (uthread_get_total_quantums () - start > 2 * UTHREAD_MLFQ_BOOST_QUANTUMS)
+    fail ("the hog was not boosted in time");
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
@@ -0,0 +1,65 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+volatile long short_spins = 0;
+volatile long long_spins = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void short_hog()
+{
+  while (true)
+  {
+    short_spins++;
+  }
+}
+
+void long_hog()
+{
+  while (true)
+  {
+    long_spins++;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (5000);
+  uthread_attr_t attr;
+  uthread_attr_init (&attr);
+  int tid_short = uthread_spawn_ex (short_hog, &attr);
+  attr.quantum_usecs = 40000;
+  int tid_long = uthread_spawn_ex (long_hog, &attr);
+  if (uthread_get_quantum (0) != 5000 || uthread_get_quantum (tid_short) != 5000 || uthread_get_quantum (tid_long) != 40000)
+    fail ("uthread_get_quantum return value");
+  if (uthread_set_quantum (tid_short, -1) != -1 || uthread_set_quantum (9, 10) != -1 || uthread_get_quantum (9) != -1)
+    fail ("bad input was accepted");
+  attr.quantum_usecs = -1;
+  if (uthread_spawn_ex (short_hog, &attr) != -1)
+    fail ("uthread_spawn_ex with a negative quantum");
+
+  // every thread gets the same number of quantums, so the long hog gets several times the CPU
+  int start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 30)
+  {
+  }
+  if (long_spins < 2 * short_spins)
+    fail ("the long quantum is not longer");
+
+  // back to the global quantum, and the CPU is shared about equally
+  uthread_set_quantum (tid_long, 0);
+  long spins_short = short_spins, spins_long = long_spins;
+  start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 30)
+  {
+  }
+  if (long_spins - spins_long > 2 * (short_spins - spins_short) || uthread_get_quantum (tid_long) != 5000)
+    fail ("uthread_set_quantum back to the global quantum");
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
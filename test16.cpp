@@ -0,0 +1,74 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+volatile long light_spins = 0;
+volatile long heavy_spins = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void light()
+{
+  while (true)
+  {
+    light_spins++;
+  }
+}
+
+void heavy()
+{
+  while (true)
+  {
+    heavy_spins++;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (5000);
+  if (uthread_set_sched_policy (UTHREAD_SCHED_FAIR) != 0)
+    fail ("uthread_set_sched_policy return value");
+  uthread_attr_t attr;
+  uthread_attr_init (&attr);
+  int tid_light = uthread_spawn_ex (light, &attr);
+  attr.weight = 3 * UTHREAD_WEIGHT_DEFAULT;
+  int tid_heavy = uthread_spawn_ex (heavy, &attr);
+  if (uthread_get_weight (tid_light) != UTHREAD_WEIGHT_DEFAULT || uthread_get_weight (tid_heavy) != 3 * UTHREAD_WEIGHT_DEFAULT)
+    fail ("uthread_get_weight return value");
+  attr.weight = 0;
+  if (uthread_spawn_ex (light, &attr) != -1 || uthread_set_weight (tid_light, -3) != -1 || uthread_get_weight (8) != -1
+      || uthread_get_vruntime (8) != -1)
+    fail ("bad input was accepted");
+
+  // the heavy thread gets about 3 times the CPU time of the light one
+  int start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 50)
+  {
+  }
+  double ratio = (double) heavy_spins / light_spins;
+  if (ratio < 2 || ratio > 4.5)
+    fail ("the CPU is not shared by the weights");
+
+  // and both are charged about the same virtual runtime
+  long long vruntime_light = uthread_get_vruntime (tid_light);
+  long long vruntime_heavy = uthread_get_vruntime (tid_heavy);
+  if (vruntime_light <= 0 || vruntime_heavy < vruntime_light / 2 || vruntime_heavy > vruntime_light * 2)
+    fail ("the virtual runtimes are not close");
+
+  // with equal weights they share the CPU about equally
+  uthread_set_weight (tid_heavy, UTHREAD_WEIGHT_DEFAULT);
+  long spins_light = light_spins, spins_heavy = heavy_spins;
+  start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 50)
+  {
+  }
+  ratio = (double) (heavy_spins - spins_heavy) / (light_spins - spins_light);
+  if (ratio < 0.5 || ratio > 2)
+    fail ("the CPU is not shared equally after uthread_set_weight");
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
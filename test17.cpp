@@ -0,0 +1,93 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define JOBS 10
+
+volatile int fast_starts[JOBS];
+volatile int fast_jobs = 0;
+volatile int slow_jobs = 0;
+volatile int late_jobs = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void burn (int quantums)
+{
+  int start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + quantums)
+  {
+  }
+}
+
+void fast()
+{
+  while (fast_jobs < JOBS)
+  {
+    fast_starts[fast_jobs++] = uthread_get_total_quantums ();
+    uthread_wait_next_period ();
+  }
+  uthread_set_deadline (uthread_get_tid (), 0, 0);
+  while (true)
+  {
+  }
+}
+
+void slow()
+{
+  while (true)
+  {
+    slow_jobs++;
+    burn (1);
+    uthread_wait_next_period ();
+  }
+}
+
+void late()
+{
+  while (true)
+  {
+    late_jobs++;
+    burn (2); // longer than its deadline
+    uthread_wait_next_period ();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (1000);
+  if (uthread_set_sched_policy (UTHREAD_SCHED_EDF) != 0)
+    fail ("uthread_set_sched_policy return value");
+  int tid_fast = uthread_spawn (fast);
+  int tid_slow = uthread_spawn (slow);
+  if (uthread_set_deadline (tid_fast, 4, 5) != -1 || uthread_set_deadline (tid_fast, 4, 0) != -1
+      || uthread_set_deadline (0, 4, 2) != -1 || uthread_wait_next_period () != -1)
+    fail ("bad input was accepted");
+
+  // the deadline threads run before main, each job as soon as it is released
+  int start = uthread_get_total_quantums ();
+  uthread_set_deadline (tid_fast, 4, 2);
+  uthread_set_deadline (tid_slow, 6, 6);
+  while (fast_jobs < JOBS)
+  {
+  }
+  for (int i = 0; i < JOBS; i++)
+  {
+    if (fast_starts[i] < start + 4 * i || fast_starts[i] >= start + 4 * i + 2)
+      fail ("a job did not run between its release and its deadline");
+  }
+  if (slow_jobs < 5 || uthread_get_deadline_misses (tid_fast) != 0 || uthread_get_deadline_misses (tid_slow) != 0)
+    fail ("deadline missed");
+
+  // a thread whose jobs are longer than its deadline misses it
+  int tid_late = uthread_spawn (late);
+  uthread_set_deadline (tid_late, 8, 1);
+  burn (40);
+  if (late_jobs < 2 || uthread_get_deadline_misses (tid_late) == 0 || uthread_get_deadline_misses (99) != -1)
+    fail ("the late jobs were not counted");
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
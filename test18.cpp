@@ -0,0 +1,62 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void hog()
+{
+  while (true)
+  {
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (1000);
+  if (uthread_set_sched_policy (UTHREAD_SCHED_STRIDE) != 0)
+    fail ("uthread_set_sched_policy return value");
+  uthread_attr_t attr;
+  uthread_attr_init (&attr);
+  int tid_one = uthread_spawn_ex (hog, &attr); // UTHREAD_TICKETS_DEFAULT, like main
+  attr.tickets = 3 * UTHREAD_TICKETS_DEFAULT;
+  int tid_three = uthread_spawn_ex (hog, &attr);
+  if (uthread_get_tickets (tid_one) != UTHREAD_TICKETS_DEFAULT || uthread_get_tickets (tid_three) != 3 * UTHREAD_TICKETS_DEFAULT)
+    fail ("uthread_get_tickets return value");
+  attr.tickets = 0;
+  if (uthread_spawn_ex (hog, &attr) != -1 || uthread_set_tickets (tid_one, UTHREAD_TICKETS_MAX + 1) != -1
+      || uthread_set_tickets (5, 1) != -1 || uthread_get_tickets (5) != -1)
+    fail ("bad input was accepted");
+
+  // the quantums are shared 1:1:3, exactly up to the order in a round
+  int one = uthread_get_quantums (tid_one), three = uthread_get_quantums (tid_three);
+  int start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 100)
+  {
+  }
+  one = uthread_get_quantums (tid_one) - one;
+  three = uthread_get_quantums (tid_three) - three;
+  if (one < 18 || one > 22 || three < 58 || three > 62)
+    fail ("the quantums are not shared by the tickets");
+
+  // the change applies right away: 1:3:3 from now on
+  uthread_set_tickets (tid_one, 3 * UTHREAD_TICKETS_DEFAULT);
+  one = uthread_get_quantums (tid_one);
+  three = uthread_get_quantums (tid_three);
+  int mine = uthread_get_quantums (0);
+  start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 70)
+  {
+  }
+  one = uthread_get_quantums (tid_one) - one;
+  three = uthread_get_quantums (tid_three) - three;
+  mine = uthread_get_quantums (0) - mine;
+  if (one < 28 || one > 32 || three < 28 || three > 32 || mine < 8 || mine > 12)
+    fail ("uthread_set_tickets did not apply right away");
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
@@ -0,0 +1,90 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+#include <sys/resource.h>
+
+volatile int other_runs = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+long user_msecs ()
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000;
+}
+
+// spins on plain arithmetic, so the time is user time that ITIMER_VIRTUAL counts (polling clock() spends most of it
+// in the kernel)
+void burn_cpu (int msecs)
+{
+  volatile unsigned long sum = 0;
+  long end = user_msecs () + msecs;
+  while (user_msecs () < end)
+  {
+    for (unsigned long i = 0; i < 1000000; i++)
+    {
+      sum += i * i;
+    }
+  }
+}
+
+void other()
+{
+  other_runs++;
+  burn_cpu (20); // preempted on time, main is READY
+  other_runs++;
+}
+
+void sleeper()
+{
+  uthread_sleep (3);
+  other_runs++;
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (1000);
+  uthread_set_tickless (1);
+
+  // main is alone, so no quantum passes
+  int start = uthread_get_total_quantums ();
+  burn_cpu (50);
+  if (uthread_get_total_quantums () != start)
+    fail ("quantums passed while main was alone");
+
+  // a READY thread starts the timer again
+  uthread_spawn (other);
+  while (other_runs < 2)
+  {
+  }
+  if (uthread_get_total_quantums () < start + 2)
+    fail ("the timer did not start with another READY thread");
+
+  // the other thread ended, so the timer stops again
+  uthread_yield ();
+  start = uthread_get_total_quantums ();
+  burn_cpu (50);
+  if (uthread_get_total_quantums () != start)
+    fail ("quantums passed after the other thread ended");
+
+  // a sleeping thread needs the quantums to pass
+  uthread_spawn (sleeper);
+  uthread_yield ();
+  while (other_runs < 3)
+  {
+  }
+
+  // and without tickless mode the quantums always pass
+  uthread_set_tickless (0);
+  start = uthread_get_total_quantums ();
+  burn_cpu (50);
+  if (uthread_get_total_quantums () == start)
+    fail ("no quantum passed without tickless mode");
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
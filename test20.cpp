@@ -0,0 +1,75 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+#include <time.h>
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void hog()
+{
+  while (true)
+  {
+  }
+}
+
+long long now_ns ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (50);
+  uthread_spawn (hog);
+  uthread_spawn (hog);
+  uthread_timer_stats_t stats;
+  if (uthread_set_timer_backend (3) != -1)
+    fail ("uthread_set_timer_backend with an unknown backend");
+
+  // 50us quanta on the monotonic clock: about 1000 quantums in 50ms
+  if (uthread_set_timer_backend (UTHREAD_TIMER_MONOTONIC) != 0)
+    fail ("uthread_set_timer_backend return value");
+  int start = uthread_get_total_quantums ();
+  long long end = now_ns () + 50000000LL;
+  while (now_ns () < end)
+  {
+  }
+  int quantums = uthread_get_total_quantums () - start;
+  uthread_get_timer_stats (&stats);
+  if (quantums < 200 || stats.expirations < 200)
+    fail ("the monotonic timer is not fine-grained");
+  if (stats.mean_jitter_ns < 0 || stats.mean_jitter_ns > stats.max_jitter_ns || stats.mean_jitter_ns > 1000000)
+    fail ("wrong jitter stats");
+
+  // the thread CPU-time clock ends the quantums as well
+  uthread_set_timer_backend (UTHREAD_TIMER_CPUTIME);
+  uthread_set_quantum (0, 1000);
+  uthread_get_timer_stats (&stats);
+  if (stats.expirations != 0)
+    fail ("the stats were not cleared");
+  start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 20)
+  {
+  }
+  uthread_get_timer_stats (&stats);
+  if (stats.expirations == 0)
+    fail ("no expiration of the CPU-time timer");
+
+  if (uthread_get_timer_stats (NULL) != -1)
+    fail ("null stats were accepted");
+
+  // and back to the itimer
+  uthread_set_timer_backend (UTHREAD_TIMER_ITIMER);
+  start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + 5)
+  {
+  }
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
@@ -0,0 +1,64 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+volatile int woke_up = 0;
+volatile sig_atomic_t alarm_handled = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+long long clock_ms (clockid_t clock)
+{
+  struct timespec now;
+  clock_gettime (clock, &now);
+  return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+void sleeper()
+{
+  uthread_sleep (20);
+  woke_up = 1;
+}
+
+void on_alarm (int sig)
+{
+  alarm_handled = 1;
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (10000);
+  uthread_spawn (sleeper);
+  uthread_yield (); // the sleeper goes to sleep
+
+  // 20 quantums of 10ms pass in about 200ms of wall-clock time, without using the CPU
+  long long wall = clock_ms (CLOCK_MONOTONIC);
+  long long cpu = clock_ms (CLOCK_PROCESS_CPUTIME_ID);
+  while (!woke_up)
+  {
+    uthread_idle ();
+  }
+  wall = clock_ms (CLOCK_MONOTONIC) - wall;
+  cpu = clock_ms (CLOCK_PROCESS_CPUTIME_ID) - cpu;
+  if (wall < 150 || wall > 1000)
+    fail ("the sleeping thread did not wake up on wall-clock time");
+  if (cpu > 50)
+    fail ("the idle main thread used the CPU");
+
+  // with no sleeping thread, main waits for a signal
+  signal (SIGALRM, on_alarm);
+  ualarm (50000, 0);
+  while (!alarm_handled)
+  {
+    uthread_idle ();
+  }
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
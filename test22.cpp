@@ -0,0 +1,104 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define SPINNERS 6
+
+volatile long counts[SPINNERS + 1];
+volatile int workers_seen[SPINNERS + 1];
+volatile int woke_up = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void spinner()
+{
+  int tid = uthread_get_tid ();
+  while (true)
+  {
+    counts[tid]++;
+    workers_seen[tid] |= 1 << uthread_get_worker ();
+  }
+}
+
+void sleeper()
+{
+  uthread_sleep (10);
+  woke_up = 1;
+}
+
+void wait_quantums (int quantums)
+{
+  int start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + quantums)
+  {
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (uthread_init_workers (1000, 16, 3) != 0)
+    fail ("uthread_init_workers return value");
+  if (uthread_set_sched_policy (UTHREAD_SCHED_RR) != 0 || uthread_set_sched_policy (UTHREAD_SCHED_PRIORITY) != -1
+      || uthread_set_tickless (1) != -1)
+    fail ("only round-robin is supported with workers");
+  for (int i = 1; i <= SPINNERS; i++)
+  {
+    if (uthread_spawn (spinner) != i)
+      fail ("uthread_spawn return value");
+  }
+
+  // the spinners are stolen by the idle workers, and every one of them runs
+  wait_quantums (300);
+  int all_seen = 0;
+  for (int i = 1; i <= SPINNERS; i++)
+  {
+    if (counts[i] == 0)
+      fail ("a spinner never ran");
+    all_seen |= workers_seen[i];
+  }
+  if (all_seen != 7)
+    fail ("the threads did not run on all the workers");
+
+  // a blocked spinner stops (once its worker takes it off the CPU), and a resumed one runs again
+  if (uthread_block (1) != 0)
+    fail ("uthread_block return value");
+  wait_quantums (30);
+  long blocked_count = counts[1];
+  wait_quantums (100);
+  if (counts[1] != blocked_count)
+    fail ("a blocked thread ran");
+  if (uthread_resume (1) != 0)
+    fail ("uthread_resume return value");
+  wait_quantums (100);
+  if (counts[1] == blocked_count)
+    fail ("a resumed thread did not run");
+
+  // a sleeping thread wakes up after the quantums passed
+  int sleeper_tid = uthread_spawn (sleeper);
+  wait_quantums (100);
+  if (!woke_up)
+    fail ("the sleeper did not wake up");
+
+  // terminated spinners are released, wherever they were, and their tids are reused
+  for (int i = 1; i <= SPINNERS; i++)
+  {
+    if (uthread_terminate (i) != 0)
+      fail ("uthread_terminate return value");
+  }
+  wait_quantums (30);
+  for (int i = 1; i <= SPINNERS; i++)
+  {
+    if (uthread_get_quantums (i) != -1)
+      fail ("a terminated thread still has its tid");
+  }
+  if (uthread_get_quantums (sleeper_tid) != -1 || uthread_spawn (spinner) != 1)
+    fail ("the tids were not reused");
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define ROUNDS 1000
+#define STARTERS 3
+
+volatile int pongs = 0;
+volatile int started_on[STARTERS + 1];
+volatile int started = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void ponger()
+{
+  while (true)
+  {
+    pongs++;
+    uthread_block (uthread_get_tid ());
+  }
+}
+
+void starter()
+{
+  started_on[uthread_get_tid () - 1] = uthread_get_worker ();
+  __sync_fetch_and_add (&started, 1);
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init_workers (1000, 16, 4);
+
+  // the ponger blocks itself after every round, and main resumes it - mostly on another worker, whose idle loop is
+  // woken up by the doorbell
+  int tid = uthread_spawn (ponger);
+  for (int round = 1; round <= ROUNDS; round++)
+  {
+    while (pongs < round)
+    {
+    }
+    while (pongs == round) // the resume is lost if it comes before the ponger blocked itself, so it is repeated
+    {
+      if (uthread_resume (tid) != 0)
+        fail ("uthread_resume return value");
+    }
+  }
+  if (uthread_terminate (tid) != 0)
+    fail ("uthread_terminate return value");
+
+  // new threads are spread over the workers
+  for (int i = 0; i < STARTERS; i++)
+  {
+    started_on[i] = -1;
+  }
+  for (int i = 0; i < STARTERS; i++)
+  {
+    if (uthread_spawn (starter) == -1)
+      fail ("uthread_spawn return value");
+  }
+  while (started < STARTERS)
+  {
+  }
+  if (started_on[0] == started_on[1] && started_on[1] == started_on[2])
+    fail ("the new threads all started on the same worker");
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
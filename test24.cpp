@@ -0,0 +1,122 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define WORKERS 3
+#define SPINNERS 6
+
+volatile long runs[SPINNERS + 2][WORKERS]; // iterations of every thread on every worker
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void spinner()
+{
+  int tid = uthread_get_tid ();
+  while (true)
+  {
+    runs[tid][uthread_get_worker ()]++;
+  }
+}
+
+void snapshot (int tid, long *copy)
+{
+  for (int i = 0; i < WORKERS; i++)
+  {
+    copy[i] = runs[tid][i];
+  }
+}
+
+int workers_ran_on (int tid, const long *before)
+{
+  // the workers the thread ran on since the snapshot
+  int workers = 0;
+  for (int i = 0; i < WORKERS; i++)
+  {
+    if (runs[tid][i] != before[i])
+      workers |= 1 << i;
+  }
+  return workers;
+}
+
+void wait_quantums (int quantums)
+{
+  int start = uthread_get_total_quantums ();
+  while (uthread_get_total_quantums () < start + quantums)
+  {
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (uthread_init_workers (1000, 16, UTHREAD_MAX_WORKERS + 1) != -1)
+    fail ("uthread_init_workers accepted too many workers");
+  if (uthread_init_workers (1000, 16, WORKERS) != 0)
+    fail ("uthread_init_workers return value");
+  if (uthread_set_affinity (0, 0) != -1 || uthread_set_affinity (0, 1ULL << WORKERS) != -1
+      || uthread_set_affinity (5, 1) != -1)
+    fail ("uthread_set_affinity accepted a wrong mask or tid");
+  if (uthread_get_affinity (0) != (1ULL << WORKERS) - 1)
+    fail ("the default affinity is not all the workers");
+  if (uthread_get_worker_queue_length (-1) != -1 || uthread_get_worker_queue_length (WORKERS) != -1)
+    fail ("uthread_get_worker_queue_length accepted a wrong worker");
+
+  for (int i = 1; i <= SPINNERS + 1; i++)
+  {
+    if (uthread_spawn (spinner) != i)
+      fail ("uthread_spawn return value");
+  }
+
+  // a thread pinned to worker 2 runs only there, even with the others idle or busy
+  int pinned = SPINNERS + 1;
+  if (uthread_set_affinity (pinned, 1 << 2) != 0 || uthread_get_affinity (pinned) != 1 << 2)
+    fail ("uthread_set_affinity return value");
+  long before[WORKERS];
+  wait_quantums (30);
+  snapshot (pinned, before);
+  wait_quantums (200);
+  int ran_on = workers_ran_on (pinned, before);
+  if (ran_on == 0)
+    fail ("the pinned thread did not run");
+  if (ran_on != 1 << 2)
+    fail ("the pinned thread ran on another worker");
+
+  // it moves when its affinity changes, to one of the workers of the new mask
+  if (uthread_set_affinity (pinned, 1 << 0 | 1 << 1) != 0)
+    fail ("uthread_set_affinity return value");
+  wait_quantums (30);
+  snapshot (pinned, before);
+  wait_quantums (200);
+  ran_on = workers_ran_on (pinned, before);
+  if (ran_on == 0 || (ran_on & 1 << 2))
+    fail ("the pinned thread did not move off worker 2");
+
+  // the free threads run on all the workers, and the READY threads are spread over them
+  int all_seen = 0;
+  long never[WORKERS] = {0};
+  for (int i = 1; i <= SPINNERS; i++)
+  {
+    if (workers_ran_on (i, never) == 0)
+      fail ("a spinner never ran");
+    all_seen |= workers_ran_on (i, never);
+  }
+  if (all_seen != (1 << WORKERS) - 1)
+    fail ("the threads did not run on all the workers");
+  int total = 0;
+  for (int i = 0; i < WORKERS; i++)
+  {
+    int length = uthread_get_worker_queue_length (i);
+    if (length < 0 || length > SPINNERS + 1)
+      fail ("uthread_get_worker_queue_length return value");
+    total += length;
+  }
+  if (total > SPINNERS + 1)
+    fail ("more READY threads than threads");
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
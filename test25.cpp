@@ -0,0 +1,142 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define WAITERS 3
+#define INCREMENTERS 4
+#define INCREMENTS 2000
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+volatile int order[WAITERS];
+volatile int owners = 0;
+volatile int arrived = 0;
+volatile long counter = 0;
+volatile int finished = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void waiter()
+{
+  arrived++;
+  if (uthread_mutex_lock (&mutex) != 0)
+    fail ("uthread_mutex_lock return value");
+  order[owners++] = uthread_get_tid ();
+  uthread_mutex_unlock (&mutex);
+}
+
+void incrementer()
+{
+  for (int i = 0; i < INCREMENTS; i++)
+  {
+    uthread_mutex_lock (&mutex);
+    long value = counter;
+    for (volatile int spin = 0; spin < 200; spin++) // long enough for the quantum to end inside
+    {
+    }
+    counter = value + 1;
+    uthread_mutex_unlock (&mutex);
+  }
+  finished++;
+}
+
+void sleeping_owner()
+{
+  uthread_mutex_lock (&mutex);
+  uthread_sleep (5);
+  owners++;
+  uthread_mutex_unlock (&mutex);
+}
+
+void wait_for_arrivals (int count)
+{
+  while (arrived < count)
+  {
+    uthread_yield ();
+  }
+  uthread_yield (); // the last one gets to the wait queue
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (100);
+  if (uthread_mutex_lock (NULL) != -1 || uthread_mutex_unlock (&mutex) != -1)
+    fail ("a null mutex, or unlocking a mutex the thread doesn't hold");
+  if (uthread_mutex_lock (&mutex) != 0 || uthread_mutex_lock (&mutex) != -1)
+    fail ("locking a mutex the thread holds");
+
+  // the waiting threads get the mutex in their order of arrival, one by one from the unlocking thread, so a thread
+  // that locks it after they arrived waits for all of them
+  for (int i = 0; i < WAITERS; i++)
+  {
+    uthread_spawn (waiter);
+  }
+  wait_for_arrivals (WAITERS);
+  if (owners != 0)
+    fail ("a thread took a held mutex");
+  if (uthread_mutex_unlock (&mutex) != 0)
+    fail ("uthread_mutex_unlock return value");
+  if (uthread_mutex_lock (&mutex) != 0)
+    fail ("uthread_mutex_lock return value");
+  if (owners != WAITERS)
+    fail ("the mutex was not handed over to the threads that waited first");
+  for (int i = 0; i < WAITERS; i++)
+  {
+    if (order[i] != i + 1)
+      fail ("the mutex was not handed over in the order of arrival");
+  }
+  uthread_mutex_unlock (&mutex);
+
+  // mutual exclusion while the threads are preempted inside it
+  for (int i = 0; i < INCREMENTERS; i++)
+  {
+    uthread_spawn (incrementer);
+  }
+  while (finished < INCREMENTERS)
+  {
+  }
+  if (counter != INCREMENTERS * INCREMENTS)
+    fail ("lost updates under the mutex");
+
+  // the main thread waits (without another READY thread) for a sleeping owner
+  owners = 0;
+  uthread_spawn (sleeping_owner);
+  uthread_yield ();
+  if (uthread_mutex_lock (&mutex) != 0 || owners != 1)
+    fail ("uthread_mutex_lock of a mutex held by a sleeping thread");
+
+  // uthread_resume doesn't wake up a waiting thread, a blocked one gets the mutex but stays blocked until it is
+  // resumed, and a terminated one leaves the wait queue
+  arrived = owners = 0;
+  int resumed = uthread_spawn (waiter);
+  int blocked = uthread_spawn (waiter);
+  int terminated = uthread_spawn (waiter);
+  wait_for_arrivals (3);
+  if (uthread_resume (resumed) != 0 || uthread_block (blocked) != 0 || uthread_terminate (terminated) != 0)
+    fail ("uthread_resume/uthread_block/uthread_terminate return value");
+  uthread_yield ();
+  if (owners != 0)
+    fail ("a waiting thread was woken up without the mutex");
+  uthread_mutex_unlock (&mutex);
+  while (owners < 1)
+  {
+    uthread_yield ();
+  }
+  uthread_yield ();
+  if (owners != 1)
+    fail ("a blocked thread ran with the mutex");
+  uthread_resume (blocked);
+  while (owners < 2)
+  {
+    uthread_yield ();
+  }
+  if (uthread_mutex_lock (&mutex) != 0 || uthread_mutex_unlock (&mutex) != 0)
+    fail ("the mutex is not free after its waiters are gone");
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
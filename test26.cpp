@@ -0,0 +1,179 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define CAPACITY 4
+#define ITEMS 500
+#define WAITERS 4
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+uthread_cond_t not_empty = UTHREAD_COND_INITIALIZER;
+uthread_cond_t not_full = UTHREAD_COND_INITIALIZER;
+uthread_cond_t go = UTHREAD_COND_INITIALIZER;
+uthread_sem_t sem = UTHREAD_SEM_INITIALIZER (0);
+
+int buffer[CAPACITY];
+int head = 0, size = 0;
+volatile long consumed_sum = 0;
+volatile int finished = 0;
+volatile int started = 0;
+volatile int going = 0;
+volatile int woke[WAITERS + 1];
+volatile int woken = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void producer()
+{
+  for (int i = 1; i <= ITEMS; i++)
+  {
+    uthread_mutex_lock (&mutex);
+    while (size == CAPACITY)
+      uthread_cond_wait (&not_full, &mutex);
+    buffer[(head + size++) % CAPACITY] = i;
+    uthread_cond_signal (&not_empty);
+    uthread_mutex_unlock (&mutex);
+  }
+  finished++;
+}
+
+void consumer()
+{
+  for (int i = 1; i <= ITEMS; i++)
+  {
+    uthread_mutex_lock (&mutex);
+    while (size == 0)
+      uthread_cond_wait (&not_empty, &mutex);
+    consumed_sum += buffer[head];
+    head = (head + 1) % CAPACITY;
+    size--;
+    uthread_cond_signal (&not_full);
+    uthread_mutex_unlock (&mutex);
+  }
+  finished++;
+}
+
+void waiter()
+{
+  uthread_mutex_lock (&mutex);
+  started++;
+  while (!going)
+    uthread_cond_wait (&go, &mutex);
+  woke[woken++] = uthread_get_tid ();
+  uthread_mutex_unlock (&mutex);
+}
+
+void sem_waiter()
+{
+  started++;
+  uthread_sem_wait (&sem);
+  woken++;
+}
+
+void sleepy_poster()
+{
+  uthread_sleep (3); // the main thread waits for the semaphore meanwhile, so no thread is READY
+  uthread_sem_post (&sem);
+}
+
+void sleepy_signaler()
+{
+  uthread_sleep (3);
+  uthread_mutex_lock (&mutex);
+  going = 1;
+  uthread_cond_signal (&go);
+  uthread_mutex_unlock (&mutex);
+}
+
+void wait_for_start (int count)
+{
+  while (started < count)
+    uthread_yield ();
+  uthread_yield ();
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (100);
+  if (uthread_cond_wait (&go, &mutex) != -1 || uthread_cond_wait (NULL, &mutex) != -1 || uthread_sem_init (&sem, -1) != -1)
+    fail ("waiting without the mutex, or a negative semaphore");
+
+  // a bounded buffer: two producers and two consumers
+  uthread_spawn (producer);
+  uthread_spawn (producer);
+  uthread_spawn (consumer);
+  uthread_spawn (consumer);
+  while (finished < 4)
+    uthread_yield ();
+  if (consumed_sum != 2L * ITEMS * (ITEMS + 1) / 2)
+    fail ("the consumers did not get every item once");
+
+  // a signal wakes up one waiter, and a broadcast all the others, in the order they waited
+  int first = uthread_spawn (waiter);
+  for (int i = 1; i < WAITERS; i++)
+    uthread_spawn (waiter);
+  wait_for_start (WAITERS);
+  uthread_mutex_lock (&mutex);
+  going = 1;
+  uthread_cond_signal (&go);
+  uthread_mutex_unlock (&mutex);
+  for (int i = 0; i < 10; i++)
+    uthread_yield ();
+  if (woken != 1 || woke[0] != first)
+    fail ("uthread_cond_signal did not wake up exactly the first waiter");
+  going = 0;
+  for (int i = 1; i < WAITERS; i++)
+    uthread_spawn (waiter); // the tid of the first waiter is reused, so it waits last
+  wait_for_start (2 * WAITERS - 1);
+  uthread_mutex_lock (&mutex);
+  going = 1;
+  if (uthread_cond_broadcast (&go) != 0)
+    fail ("uthread_cond_broadcast return value");
+  uthread_mutex_unlock (&mutex);
+  while (woken < WAITERS)
+    uthread_yield ();
+  for (int i = 1; i < WAITERS; i++)
+  {
+    if (woke[i] != first + i)
+      fail ("uthread_cond_broadcast did not wake up the waiters in order");
+  }
+  if (uthread_cond_broadcast (&go) != 0)
+    fail ("uthread_cond_broadcast without waiters");
+
+  // the permits of the semaphore go to the waiters one by one, and the rest are counted
+  started = woken = 0;
+  for (int i = 0; i < 3; i++)
+    uthread_spawn (sem_waiter);
+  wait_for_start (3);
+  uthread_sem_post (&sem);
+  uthread_sem_post (&sem);
+  for (int i = 0; i < 10; i++)
+    uthread_yield ();
+  if (woken != 2 || uthread_sem_getvalue (&sem) != 0)
+    fail ("two posts did not wake up two waiters");
+  uthread_sem_post (&sem);
+  uthread_sem_post (&sem);
+  while (woken < 3)
+    uthread_yield ();
+  if (uthread_sem_getvalue (&sem) != 1 || uthread_sem_wait (&sem) != 0 || uthread_sem_getvalue (&sem) != 0)
+    fail ("the permit left was not counted");
+
+  // the main thread waits while the only other thread sleeps, and the other thread posts or signals once it wakes up
+  uthread_spawn (sleepy_poster);
+  if (uthread_sem_wait (&sem) != 0 || uthread_sem_getvalue (&sem) != 0)
+    fail ("waiting for the post of a sleeping thread");
+  going = 0;
+  uthread_spawn (sleepy_signaler);
+  uthread_mutex_lock (&mutex);
+  while (!going)
+    uthread_cond_wait (&go, &mutex);
+  uthread_mutex_unlock (&mutex);
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+int blocker_tid;
+volatile int resumed = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void sleeping_owner()
+{
+  uthread_mutex_lock (&mutex);
+  uthread_yield ();
+  uthread_sleep (3); // main waits for the mutex, so no thread is READY
+  uthread_mutex_unlock (&mutex);
+}
+
+void blocking_owner()
+{
+  uthread_mutex_lock (&mutex);
+  uthread_yield ();
+  uthread_block (uthread_get_tid ()); // main waits and the resumer sleeps
+  uthread_mutex_unlock (&mutex);
+}
+
+void resumer()
+{
+  uthread_sleep (3);
+  resumed = 1;
+  uthread_resume (blocker_tid);
+}
+
+void holder()
+{
+  uthread_mutex_lock (&mutex);
+  uthread_sleep (3);
+  uthread_mutex_unlock (&mutex);
+}
+
+void quitter()
+{
+  uthread_yield (); // returns after main waits for the mutex, and then terminates with the holder sleeping
+}
+
+void lock_and_unlock (const char *msg)
+{
+  if (uthread_mutex_lock (&mutex) != 0)
+    fail (msg);
+  uthread_mutex_unlock (&mutex);
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (1000);
+
+  // the main thread waits for a mutex, and its owner goes to sleep
+  uthread_spawn (sleeping_owner);
+  uthread_yield ();
+  lock_and_unlock ("the mutex of a sleeping owner");
+
+  // the owner blocks itself, and a sleeping thread resumes it
+  blocker_tid = uthread_spawn (blocking_owner);
+  uthread_spawn (resumer);
+  uthread_yield ();
+  lock_and_unlock ("the mutex of a blocked owner");
+  if (!resumed)
+    fail ("the mutex was taken before its owner was resumed");
+
+  // a thread terminates while the main thread waits, and the owner sleeps
+  uthread_spawn (holder);
+  uthread_spawn (quitter);
+  uthread_yield ();
+  lock_and_unlock ("the mutex of an owner that slept while another thread terminated");
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
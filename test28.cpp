@@ -0,0 +1,44 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define ROUNDS 20
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+volatile int locked = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void sleeping_owner()
+{
+  uthread_mutex_lock (&mutex);
+  locked = 1;
+  uthread_sleep (3); // the main thread waits for the mutex, so all the workers may be idle
+  uthread_mutex_unlock (&mutex);
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init_workers (1000, 16, 2);
+
+  // the quantums the owner sleeps pass even if no worker has a thread to run
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    locked = 0;
+    if (uthread_spawn (sleeping_owner) == -1)
+      fail ("uthread_spawn return value");
+    while (!locked)
+      uthread_yield ();
+    if (uthread_mutex_lock (&mutex) != 0)
+      fail ("uthread_mutex_lock return value");
+    uthread_mutex_unlock (&mutex);
+  }
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define SPINNERS 3
+#define LOCKERS 2
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+volatile long spins[SPINNERS + 1];
+volatile long locks[LOCKERS + 1];
+volatile long shared = 0;
+volatile int naps = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+long long now_ns ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void spinner()
+{
+  int index = uthread_get_tid () - 1;
+  while (true)
+  {
+    spins[index]++;
+  }
+}
+
+void locker()
+{
+  int index = uthread_get_tid () - 1 - SPINNERS;
+  while (true)
+  {
+    uthread_mutex_lock (&mutex);
+    shared++;
+    locks[index]++;
+    if (locks[index] % 16 == 0)
+      uthread_yield (); // switches out of the library as well as out of the sig-handler
+    uthread_mutex_unlock (&mutex);
+  }
+}
+
+void napper()
+{
+  while (true)
+  {
+    uthread_sleep (1);
+    naps++;
+  }
+}
+
+void ender()
+{
+  uthread_terminate (0); // the program ends from a thread other than main, while quantums keep expiring
+}
+
+int main(int argc, char **argv)
+{
+  // 10us quanta: the timer often expires again while the sig-handler switches threads, or right after it
+  uthread_init (10);
+  if (uthread_set_timer_backend (UTHREAD_TIMER_MONOTONIC) != 0)
+    fail ("uthread_set_timer_backend return value");
+  for (int i = 0; i < SPINNERS; i++)
+    uthread_spawn (spinner);
+  for (int i = 0; i < LOCKERS; i++)
+    uthread_spawn (locker);
+  uthread_spawn (napper);
+
+  long long end = now_ns () + 300000000LL;
+  while (now_ns () < end)
+  {
+  }
+  uthread_mutex_lock (&mutex);
+  long total = 0;
+  for (int i = 0; i < LOCKERS; i++)
+  {
+    if (locks[i] == 0)
+      fail ("a locker never ran");
+    total += locks[i];
+  }
+  if (total != shared)
+    fail ("the mutex did not keep the lockers apart");
+  uthread_mutex_unlock (&mutex);
+  for (int i = 0; i < SPINNERS; i++)
+  {
+    if (spins[i] == 0)
+      fail ("a spinner never ran");
+  }
+  if (naps == 0)
+    fail ("the napper never woke up");
+
+  printf ("Test passed\n"); // on the stack of main - the other threads have small stacks
+  uthread_spawn (ender);
+  while (true)
+  {
+  }
+  return 0;
+}
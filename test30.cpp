@@ -0,0 +1,52 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define THREADS 40000 // more than vm.max_map_count (65530 by default) allows with two mappings per stack
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void idle_thread()
+{
+  while (true)
+  {
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init_ex (999999, THREADS + 1);
+  uthread_set_sched_policy (UTHREAD_SCHED_PRIORITY); // the threads never run before main, so their stacks stay untouched
+
+  // many threads with big lazy stacks cost only address space
+  uthread_attr_t attr;
+  uthread_attr_init (&attr);
+  attr.stack_size = 1024 * 1024;
+  attr.stack_mode = UTHREAD_STACK_LAZY;
+  attr.priority = UTHREAD_PRIORITY_DEFAULT - 1;
+  for (int i = 1; i <= THREADS; i++)
+  {
+    if (uthread_spawn_ex (idle_thread, &attr) != i)
+      fail ("a lazy stack could not be allocated");
+  }
+
+  // their stacks are reused after they terminate
+  for (int i = 1; i <= THREADS; i++)
+  {
+    if (uthread_terminate (i) != 0)
+      fail ("uthread_terminate return value");
+  }
+  for (int i = 1; i <= THREADS; i++)
+  {
+    if (uthread_spawn_ex (idle_thread, &attr) != i)
+      fail ("a cached lazy stack could not be reused");
+  }
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+#define WAITERS 100 // a few times the threads a broadcast takes out of the wait queue at once
+#define ROUNDS 10
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+uthread_cond_t cond = UTHREAD_COND_INITIALIZER;
+volatile int generation = 0;
+volatile int waiting = 0;
+volatile int finished = 0;
+
+void fail (const char *msg)
+{
+  printf ("Test failed: %s\n", msg);
+  exit (1);
+}
+
+void waiter()
+{
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    uthread_mutex_lock (&mutex);
+    int my_generation = generation;
+    waiting++;
+    while (generation == my_generation) // waits again right away in the next round
+      uthread_cond_wait (&cond, &mutex);
+    uthread_mutex_unlock (&mutex);
+  }
+  __atomic_add_fetch (&finished, 1, __ATOMIC_SEQ_CST);
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init_workers (1000, WAITERS + 1, 4);
+
+  for (int i = 0; i < WAITERS; i++)
+  {
+    if (uthread_spawn (waiter) == -1)
+      fail ("uthread_spawn return value");
+  }
+
+  // every broadcast wakes up all the waiters, whatever the size of its batches
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    while (true)
+    {
+      uthread_mutex_lock (&mutex);
+      if (waiting == WAITERS)
+      {
+        waiting = 0;
+        generation++;
+        if (uthread_cond_broadcast (&cond) != 0)
+          fail ("uthread_cond_broadcast return value");
+        uthread_mutex_unlock (&mutex);
+        break;
+      }
+      uthread_mutex_unlock (&mutex);
+      uthread_yield ();
+    }
+  }
+  while (finished < WAITERS)
+    uthread_yield ();
+
+  printf ("Test passed\n");
+  uthread_terminate (0);
+  return 0;
+}
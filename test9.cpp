@@ -0,0 +1,35 @@
+#include "uthreads.h"
+#include "stdio.h"
+#include <stdlib.h>
+
+void f()
+{
+  while(true);
+}
+
+int main(int argc, char **argv)
+{
+  uthread_init (999999);
+  if (uthread_reserve_threads (-1) != -1 || uthread_reserve_threads (MAX_THREAD_NUM) != 0)
+  {
+    printf ("Test failed: uthread_reserve_threads\n");
+    exit (1);
+  }
+  for (int round = 0; round < 1000; round++)
+  {
+    for (int i = 1; i < MAX_THREAD_NUM; i++)
+    {
+      if (uthread_spawn (f) != i)
+      {
+        printf ("Test failed: spawn in round %d didn't return %d\n", round, i);
+        exit (1);
+      }
+    }
+    for (int i = MAX_THREAD_NUM - 1; i > 0; i--)
+    {
+      uthread_terminate (i);
+    }
+  }
+  printf ("Test passed\n");
+  uthread_terminate(0);
+}
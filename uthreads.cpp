@@ -3,8 +3,8 @@
  * Authors: Ido Yanay, Omri Baum.
  * 
  * Notes (for implementation ): 
- * 1. need to check if realy need blocking itimer signals when runnign librarys fucntions.
- * 2. check the sigsetjmp in the init function.
+ * 1. the itimer signal is never blocked around library calls (only while the sig-handler runs) - library functions run inside a critical section (in_library), and a
+ *    SIGVTALRM that fires inside it is deferred to the end of the section.
  * 
  * TODO -- delte the notes
  */
@@ -13,50 +13,787 @@
 
  #include <iostream>
  #include <cstdlib>     // for exit()
- #include <list>        // for the list of READY threads
  #include <queue>       // for std::priority_queue
- #include <set>         // for std::set
- #include <csetjmp>     // for sigjmp_buf
- #include <setjmp.h>
+ #include <cstdint>     // for uint64_t
+ #include <vector>      // for the thread table
  #include <csignal>     // for sigemptyset
  #include <sys/time.h>  // for itimerval
+ #include <atomic>      // for std::atomic_signal_fence
+ #include <sys/mman.h>  // for mmap of the stacks
+ #include <unistd.h>    // for sysconf
+ #include <ctime>       // for clock_gettime
+ #include <poll.h>      // for ppoll
+ #include <cerrno>      // for EINTR
+ #ifndef MADV_GUARD_INSTALL
+ #define MADV_GUARD_INSTALL 102 // linux 6.13, not in older headers
+ #endif
+ #include <climits>     // for INT_MAX
+ #include <pthread.h>   // for the worker kernel threads
+ #include <sched.h>     // for sched_yield
+ #include <cstdio>      // for fflush
+ #include <sys/eventfd.h> // for the doorbells of the workers
  
  
   
   // --- typedefs, enums, structs, and decleratoins for the internal use in the library --- //
- typedef unsigned long address_t;    // for the translation function
- #define JB_SP 6
- #define JB_PC 7
+ typedef unsigned long address_t;    // for the stack and pc of the context
+ #define SIGNAL_FRAME_SIZE 4096      // extra stack room for the SIGVTALRM frame the kernel pushes on a preempted thread (~3KB with avx-512)
+ #define INITIAL_POOL_SIZE 16        // number of thread control blocks allocated by uthread_init (the pool grows when needed)
+ #define STACK_SIZE_CLASSES 48       // stack sizes are 2^i pages, for i in [0, STACK_SIZE_CLASSES)
+ #define MAX_CACHED_STACKS 64        // max number of free stacks kept for reuse in each size class
+ #define LAZY_REGION_SIZE (64ULL << 30) // address space reserved at once for the lazy stacks, which are carved out of it
+ #define STRIDE_ONE (1LL << 30)      // the stride of a thread with one ticket (UTHREAD_TICKETS_MAX tickets still get a stride of 1024)
+ #define IDLE_STACK_SIZE (64 * 1024) // stack of the idle loop of worker 0 (the other workers run it on their own kernel thread stack)
+ #define EXIT_STACK_SIZE (64 * 1024) // stack of terminate_program: exit() runs the atexit handlers and flushes the streams on it
+ #define LOCK_SPINS 64               // tries of a contended library_lock before yielding the CPU to its holder
+#define MUTEX_SPINS 100             // with workers, tries of a held uthread_mutex_t before waiting for it (its owner may unlock it soon on another worker)
+#define MUTEX_WAITERS 1             // bit of the state of a uthread_mutex_t: threads may wait in its wait queue (the rest is the tid of the owner + 1, shifted by one)
+#define BALANCE_QUANTUMS 8          // a worker balances its READY threads with the other workers once in this many of its quantums
+#define BROADCAST_BATCH 32          // with workers, threads uthread_cond_broadcast takes out of a wait queue at once (kept on the stack of the caller)
  enum class PrintType { SYSTEM_ERR, THREAD_LIB_ERR }; // print type for the error printing
  enum class BlockedType {SLEEP, BLOCK, UNBLOCKED};               // types of blocking
+ enum class ThreadState {RUNNING, READY, BLOCKED};              // which list the thread is in (BLOCKED - blocked and/or sleeping)
+ // saved CPU context of a thread (x86-64): the callee-saved registers, the stack pointer and the pc.
+ // the signal mask is not part of it - every switch is done inside the library critical section, so there is nothing to restore.
+ struct Context {
+     address_t rbx, rbp, r12, r13, r14, r15;
+     address_t sp;
+     address_t pc;
+ };
  // struct that contain all the relevant data
  struct Thread { 
      int tid;
-     sigjmp_buf env;             // CPU context (saved)
-     char stack[STACK_SIZE];     // Stack memory (only needed for non-main threads)
+     Context env;                // CPU context (saved)
+     char *stack;                // Stack memory, mmap'd with a guard page below it (only needed for non-main threads)
+     size_t stack_size;          // usable size of the stack (without the guard page)
+     bool stack_lazy;            // true if the stack is only reserved, and its pages are committed on first touch
+     thread_entry_point entry_point; // the function the thread starts from (only needed for non-main threads)
      int wake_up_quantum;        // the 'time' for a sleeping thread to wake up
      int quantom_count;          // number of runnign quantoms for this thread
-     bool blocked;               // true if the thread is blocked
+     int quantum_usecs;          // length of the quantums of this thread (0 for the global quantum_per_thread)
+     std::atomic<bool> blocked;  // true if the thread is blocked (with workers, another worker may set it while the thread runs or is READY)
+     std::atomic<bool> killed;   // with workers: terminated while it ran or was READY, and released by the worker that takes it off the CPU
      bool sleeping;              // true if the thread is sleeping
+     std::atomic<ThreadState> state; // RUNNING is running_thread, READY in the ready queue of the policy, BLOCKED in blocked_threads
+     int worker;                 // the worker that runs the thread, or ran it last (always 0 without workers)
+     std::atomic<bool> parked;   // with workers: blocked and off the CPU (in no list), so uthread_resume makes it READY
+     Thread *inbox_next;         // link in the inbox of a worker
+     std::atomic<unsigned long long> affinity; // the workers the thread may run on (bit i for worker i)
+     std::atomic<uthread_wait_queue_t*> wait_queue; // the wait queue of the mutex, condition variable or semaphore the thread waits in (nullptr if none). it is BLOCKED, and not in blocked_threads
+     bool in_handler;            // true from a preemption by the sig-handler until the thread returns from it (its signal frame is on its stack)
+     int priority;               // scheduling priority, for UTHREAD_SCHED_PRIORITY (higher runs first)
+     int mlfq_level;             // level for UTHREAD_SCHED_MLFQ (0 is the top). only valid if mlfq_epoch is the current one
+     int mlfq_epoch;             // the boost epoch mlfq_level belongs to. an older one means the thread was boosted to level 0
+     int weight;                 // share of the CPU for UTHREAD_SCHED_FAIR, relative to UTHREAD_WEIGHT_DEFAULT
+     long long vruntime;         // CPU time used (ns) scaled by UTHREAD_WEIGHT_DEFAULT / weight, for UTHREAD_SCHED_FAIR
+     int period;                 // period in quantums of a deadline thread (0 if it has no deadline)
+     int relative_deadline;      // deadline of every job, in quantums from its release
+     int absolute_deadline;      // the quantum the current job should be done by, for UTHREAD_SCHED_EDF
+     int next_release;           // the quantum the next job is released at
+     int deadline_misses;        // number of jobs that were done after their deadline
+     int tickets;                // share of the CPU for UTHREAD_SCHED_STRIDE
+     long long stride;           // STRIDE_ONE / tickets - what a quantum adds to the pass
+     long long pass;             // the virtual time of the thread for UTHREAD_SCHED_STRIDE, the lowest runs next
+     Thread *next, *prev;        // links in the queue of its state (intrusive, so moving between queues never allocates)
+     int heap_index;             // position in the sleeping heap, or in the ready heap of the policy (-1 if in none)
+ };
+
+ // intrusive doubly-linked queue of threads, using the next/prev links inside the Thread. a thread is in at most one
+ // queue at a time, and every operation is O(1) without allocating - safe to use from the sig-handler.
+ class ThreadQueue {
+ public:
+     bool empty() const { return head == nullptr; }
+     size_t size() const { return count; }
+     Thread* front() const { return head; }
+
+     void push_back(Thread* thread)
+     {
+         thread->next = nullptr;
+         thread->prev = tail;
+         if (tail != nullptr) {
+             tail->next = thread;
+         } else {
+             head = thread;
+         }
+         tail = thread;
+         count++;
+     }
+
+     void push_front(Thread* thread)
+     {
+         thread->prev = nullptr;
+         thread->next = head;
+         if (head != nullptr) {
+             head->prev = thread;
+         } else {
+             tail = thread;
+         }
+         head = thread;
+         count++;
+     }
+
+     void remove(Thread* thread)
+     {
+         if (thread->prev != nullptr) {
+             thread->prev->next = thread->next;
+         } else {
+             head = thread->next;
+         }
+         if (thread->next != nullptr) {
+             thread->next->prev = thread->prev;
+         } else {
+             tail = thread->prev;
+         }
+         thread->next = thread->prev = nullptr;
+         count--;
+     }
+
+     Thread* pop_front()
+     {
+         Thread* thread = head;
+         remove(thread);
+         return thread;
+     }
+
+     void splice_back(ThreadQueue& other)
+     {
+         // moving all the threads of other to the end of this queue, in O(1)
+         if (other.head == nullptr) {
+             return;
+         }
+         if (tail != nullptr) {
+             tail->next = other.head;
+             other.head->prev = tail;
+         } else {
+             head = other.head;
+         }
+         tail = other.tail;
+         count += other.count;
+         other.head = other.tail = nullptr;
+         other.count = 0;
+     }
+
+ private:
+     Thread* head = nullptr;
+     Thread* tail = nullptr;
+     size_t count = 0;
+ };
+
+ // a queue of threads per level, and a bitmap of the non-empty levels, so the highest non-empty level is found
+ // with a single instruction and push/pop stay O(1) whatever the number of levels.
+ class LevelQueues {
+ public:
+     static const int LEVELS = 32;
+     static_assert(UTHREAD_PRIORITY_LEVELS <= LEVELS && UTHREAD_MLFQ_LEVELS <= LEVELS, "the level bitmap is 32 bits");
+
+     bool empty() const { return bitmap == 0; }
+     size_t size() const { return count; }
+     int top_level() const { return 31 - __builtin_clz(bitmap); } // only when not empty
+
+     void push_back(Thread* thread, int level)
+     {
+         queues[level].push_back(thread);
+         bitmap |= 1u << level;
+         count++;
+     }
+
+     void remove(Thread* thread, int level)
+     {
+         queues[level].remove(thread);
+         if (queues[level].empty()) {
+             bitmap &= ~(1u << level);
+         }
+         count--;
+     }
+
+     Thread* pop_front()
+     {
+         // the first thread of the highest non-empty level
+         int level = top_level();
+         Thread* thread = queues[level].front();
+         remove(thread, level);
+         return thread;
+     }
+
+     void merge_into(int to_level)
+     {
+         // moving the threads of all the levels to the end of to_level, from the highest level down. O(LEVELS).
+         for (int level = LEVELS - 1; level >= 0; level--) {
+             if (level != to_level) {
+                 queues[to_level].splice_back(queues[level]);
+             }
+         }
+         bitmap = count > 0 ? 1u << to_level : 0;
+     }
+
+ private:
+     ThreadQueue queues[LEVELS];
+     uint32_t bitmap = 0;
+     size_t count = 0;
+ };
+
+ // binary min-heap of threads, ordered by 'less'. every thread keeps its index in the heap (heap_index),
+ // so a thread can be removed from the middle in O(log n) and not only popped.
+ class ThreadHeap {
+ public:
+     typedef bool (*Compare)(const Thread* a, const Thread* b);
+     explicit ThreadHeap(Compare less) : less(less) {}
+
+     void reserve(size_t capacity) { heap.reserve(capacity); } // so push does not allocate
+     bool empty() const { return heap.empty(); }
+     size_t size() const { return heap.size(); }
+     Thread* top() const { return heap.front(); }
+     void clear() { heap.clear(); }
+
+     void push(Thread* thread)
+     {
+         heap.push_back(thread);
+         sift_up(heap.size() - 1);
+     }
+
+     void remove(Thread* thread)
+     {
+         // moving the last thread to the removed place, and fixing the heap from there (up or down).
+         size_t index = thread->heap_index;
+         Thread* last = heap.back();
+         heap.pop_back();
+         thread->heap_index = -1;
+         if (last != thread) {
+             place(index, last);
+             sift_up(index);
+             sift_down(last->heap_index);
+         }
+     }
+
+     Thread* pop()
+     {
+         Thread* thread = heap.front();
+         remove(thread);
+         return thread;
+     }
+
+ private:
+     std::vector<Thread*> heap;
+     Compare less;
+
+     void place(size_t index, Thread* thread)
+     {
+         heap[index] = thread;
+         thread->heap_index = (int) index;
+     }
+
+     void sift_up(size_t index)
+     {
+         Thread* thread = heap[index];
+         while (index > 0 && less(thread, heap[(index - 1) / 2])) {
+             place(index, heap[(index - 1) / 2]);
+             index = (index - 1) / 2;
+         }
+         place(index, thread);
+     }
+
+     void sift_down(size_t index)
+     {
+         Thread* thread = heap[index];
+         while (true) {
+             size_t child = 2 * index + 1;
+             if (child >= heap.size()) {
+                 break;
+             }
+             if (child + 1 < heap.size() && less(heap[child + 1], heap[child])) {
+                 child++;
+             }
+             if (!less(heap[child], thread)) {
+                 break;
+             }
+             place(index, heap[child]);
+             index = child;
+         }
+         place(index, thread);
+     }
+ };
+
+ // allocator of tids, on a bitmap of the free tids (bit set = free), 64 tids per word.
+ // the lowest free tid is found with find-first-set, starting from the lowest word that may still have a free bit,
+ // so allocating is O(words) at worst and O(1) in the common case, and releasing/checking a tid is O(1).
+ class TidAllocator {
+ public:
+     void init(int capacity)
+     {
+         // all the tids in [0, capacity) are free
+         free_bits.assign((capacity + 63) / 64, ~(uint64_t) 0);
+         if (capacity % 64 != 0) {
+             free_bits.back() = ((uint64_t) 1 << (capacity % 64)) - 1;
+         }
+         first_free_word = 0;
+     }
+
+     int allocate()
+     {
+         // taking the lowest free tid. return -1 if all the tids are used.
+         while (first_free_word < free_bits.size() && free_bits[first_free_word] == 0) {
+             first_free_word++;
+         }
+         if (first_free_word == free_bits.size()) {
+             return -1;
+         }
+         int bit = __builtin_ctzll(free_bits[first_free_word]);
+         free_bits[first_free_word] &= ~((uint64_t) 1 << bit);
+         return (int) first_free_word * 64 + bit;
+     }
+
+     void release(int tid)
+     {
+         size_t word = tid / 64;
+         free_bits[word] |= (uint64_t) 1 << (tid % 64);
+         if (word < first_free_word) {
+             first_free_word = word;
+         }
+     }
+
+     bool is_used(int tid) const
+     {
+         return tid >= 0 && (size_t) tid / 64 < free_bits.size() && !(free_bits[tid / 64] & ((uint64_t) 1 << (tid % 64)));
+     }
+
+ private:
+     std::vector<uint64_t> free_bits;
+     size_t first_free_word = 0;   // no free tid below this word
+ };
+
+ // pool of Thread control blocks. the threads are allocated in slabs (arrays) and kept in a free-list (linked by 'next')
+ // after they terminate, so spawning and terminating a thread does not use the heap unless the pool has to grow.
+ class ThreadPool {
+ public:
+     size_t available() const { return free_count; }
+
+     void grow(size_t count)
+     {
+         // allocating one more slab of 'count' threads, all of them free
+         Thread* slab = new Thread[count];
+         slabs.push_back(slab);
+         total_count += count;
+         for (size_t i = 0; i < count; i++) {
+             release(&slab[i]);
+         }
+     }
+
+     Thread* take()
+     {
+         // taking a free thread (doubling the pool if there is none)
+         if (free_list == nullptr) {
+             grow(total_count == 0 ? INITIAL_POOL_SIZE : total_count);
+         }
+         Thread* thread = free_list;
+         free_list = thread->next;
+         free_count--;
+         return thread;
+     }
+
+     void release(Thread* thread)
+     {
+         thread->next = free_list;
+         free_list = thread;
+         free_count++;
+     }
+
+     void destroy()
+     {
+         // freeing all the slabs, with the threads that are still used.
+         for (Thread* slab : slabs) {
+             delete[] slab;
+         }
+         slabs.clear();
+         free_list = nullptr;
+         free_count = 0;
+         total_count = 0;
+     }
+
+ private:
+     std::vector<Thread*> slabs;
+     Thread* free_list = nullptr;
+     size_t free_count = 0;
+     size_t total_count = 0;     // free and used
+ };
+
+ // pool of thread stacks. every stack has a PROT_NONE guard page below it, so an overflow crashes with SIGSEGV instead
+ // of silently corrupting other memory. the sizes are rounded up to a power of two pages, and a freed stack is kept in
+ // the free-list of its mode and size class for the next spawn, so releasing one never allocates and reusing one makes
+ // no syscall. the free-list node is at the top of the stack - the page the next thread touches first.
+ // a fixed stack is a mapping of its own. a lazy stack is only reserved (MAP_NORESERVE): the kernel commits its pages
+ // on first touch, and they are given back with MADV_DONTNEED when it is released, so a big mostly-idle stack costs
+ // only the pages it really uses. the lazy stacks are carved out of large reservations (regions), with guard pages
+ // that don't split the region where the kernel supports guard regions - so even 100k+ of them take a few mappings,
+ // and not two each (vm.max_map_count). a carved stack is never unmapped on its own, only with its region.
+ class StackPool {
+ public:
+     char* take(size_t min_size, bool lazy, size_t& size)
+     {
+         // taking a stack with at least min_size usable bytes (at most max_size()). its actual usable size is
+         // returned in 'size'. returns nullptr if it can't be mapped.
+         int size_class = get_size_class(min_size);
+         size = page_size() << size_class;
+         FreeStack*& free_list = free_lists[lazy][size_class];
+         if (free_list != nullptr) {
+             FreeStack* node = free_list;
+             free_list = node->next;
+             cached[lazy][size_class]--;
+             return node->stack;
+         }
+         if (in_region(size, lazy)) {
+             return carve(size);
+         }
+         int flags = MAP_PRIVATE | MAP_ANONYMOUS | (lazy ? MAP_NORESERVE : 0);
+         void* mapping = mmap(nullptr, size + page_size(), PROT_READ | PROT_WRITE, flags, -1, 0);
+         if (mapping == MAP_FAILED) {
+             return nullptr;
+         }
+         if (mprotect(mapping, page_size(), PROT_NONE) != 0) { // the guard page, at the low end (stacks grow down)
+             munmap(mapping, size + page_size());
+             return nullptr;
+         }
+         return (char*) mapping + page_size();
+     }
+
+     void release(char* stack, size_t size, bool lazy)
+     {
+         // keeping the stack for reuse, or unmapping it if its size class has enough cached stacks (a carved stack is
+         // always kept - its address space is reserved anyway).
+         int size_class = get_size_class(size);
+         if (!in_region(size, lazy) && cached[lazy][size_class] >= MAX_CACHED_STACKS) {
+             unmap(stack, size, lazy);
+             return;
+         }
+         if (lazy) {
+             madvise(stack, size, MADV_DONTNEED); // giving the touched pages back to the kernel
+         }
+         FreeStack* node = (FreeStack*) (stack + size) - 1;
+         node->stack = stack;
+         node->next = free_lists[lazy][size_class];
+         free_lists[lazy][size_class] = node;
+         cached[lazy][size_class]++;
+     }
+
+     void destroy()
+     {
+         // unmapping all the cached stacks, and the regions with all the stacks carved out of them
+         for (int lazy = 0; lazy < 2; lazy++) {
+             for (int size_class = 0; size_class < STACK_SIZE_CLASSES; size_class++) {
+                 while (free_lists[lazy][size_class] != nullptr) {
+                     FreeStack* node = free_lists[lazy][size_class];
+                     free_lists[lazy][size_class] = node->next;
+                     unmap(node->stack, page_size() << size_class, lazy);
+                 }
+                 cached[lazy][size_class] = 0;
+             }
+         }
+         for (char* region : regions) {
+             munmap(region, LAZY_REGION_SIZE);
+         }
+         regions.clear();
+         region_next = region_end = nullptr;
+     }
+
+     void unmap(char* stack, size_t size, bool lazy)
+     {
+         // unmapping a stack with its guard page, unless it was carved out of a region.
+         if (!in_region(size, lazy)) {
+             munmap(stack - page_size(), size + page_size());
+         }
+     }
+
+     static size_t page_size()
+     {
+         static const size_t size = sysconf(_SC_PAGESIZE);
+         return size;
+     }
+
+     static size_t max_size()
+     {
+         return page_size() << (STACK_SIZE_CLASSES - 1);
+     }
+
+ private:
+     struct FreeStack { FreeStack* next; char* stack; };
+     FreeStack* free_lists[2][STACK_SIZE_CLASSES] = {};  // [lazy][size class]
+     size_t cached[2][STACK_SIZE_CLASSES] = {};
+     std::vector<char*> regions;   // the reservations the lazy stacks are carved out of
+     char* region_next = nullptr;  // the unused part of the last region
+     char* region_end = nullptr;
+
+     static bool in_region(size_t size, bool lazy)
+     {
+         return lazy && size + page_size() <= LAZY_REGION_SIZE;
+     }
+
+     char* carve(size_t size)
+     {
+         // taking a guard page and a lazy stack above it from the last region, or from a new one if it is used up
+         // (the rest of the old one is left unused - it is only address space).
+         if ((size_t) (region_end - region_next) < size + page_size()) {
+             void* mapping = mmap(nullptr, LAZY_REGION_SIZE, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+             if (mapping == MAP_FAILED) {
+                 return nullptr;
+             }
+             regions.push_back((char*) mapping);
+             region_next = (char*) mapping;
+             region_end = region_next + LAZY_REGION_SIZE;
+         }
+         char* guard = region_next;
+         if (madvise(guard, page_size(), MADV_GUARD_INSTALL) != 0 &&  // no new mapping
+             mprotect(guard, page_size(), PROT_NONE) != 0) {          // older kernels: the region is split around it
+             return nullptr;
+         }
+         region_next += size + page_size();
+         return guard + page_size();
+     }
+
+     static int get_size_class(size_t size)
+     {
+         int size_class = 0;
+         while ((page_size() << size_class) < size) {
+             size_class++;
+         }
+         return size_class;
+     }
+ };
+
+ // Chase-Lev work-stealing deque of the READY threads of a worker. only the worker that owns it pushes (at the bottom),
+ // and every worker - the owner as well - takes from the top with a CAS, so the threads of a worker run in FIFO order
+ // and a thief never waits for the owner. a thread is in at most one deque, so max_threads slots are always enough and
+ // the array never grows (it is only reserved, like a lazy stack, so the slots that are never used cost no memory).
+ class WorkDeque {
+ public:
+     bool init(size_t capacity)
+     {
+         size_t size = 1;
+         while (size < capacity) {
+             size <<= 1;
+         }
+         void* mapping = mmap(nullptr, size * sizeof(std::atomic<Thread*>), PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+         if (mapping == MAP_FAILED) {
+             return false;
+         }
+         slots = (std::atomic<Thread*>*) mapping;
+         mask = size - 1;
+         return true;
+     }
+
+     size_t size() const
+     {
+         // only a snapshot - the other workers may take threads meanwhile
+         long size = bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+         return size > 0 ? size : 0;
+     }
+
+     void push(Thread* thread)
+     {
+         // only by the owner
+         long b = bottom.load(std::memory_order_relaxed);
+         slots[b & mask].store(thread, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_release); // the thread (and the slot) before the new bottom
+         bottom.store(b + 1, std::memory_order_relaxed);
+     }
+
+     Thread* steal()
+     {
+         // taking the thread at the top, or nullptr if the deque is empty. retries if another worker took it first.
+         while (true) {
+             long t = top.load(std::memory_order_acquire);
+             std::atomic_thread_fence(std::memory_order_seq_cst);
+             long b = bottom.load(std::memory_order_acquire);
+             if (t >= b) {
+                 return nullptr;
+             }
+             Thread* thread = slots[t & mask].load(std::memory_order_relaxed);
+             if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                 return thread;
+             }
+         }
+     }
+
+ private:
+     std::atomic<long> top{0};
+     std::atomic<long> bottom{0};
+     std::atomic<Thread*>* slots = nullptr;
+     size_t mask = 0;
+ };
+
+ // the inbox of a worker: the threads other workers made READY on it (the deque is only pushed by its owner).
+ // any worker pushes with a CAS, and the owner takes all of them with a single exchange, so there is no ABA
+ // and no lock. the threads are linked through inbox_next, newest first.
+ class Inbox {
+ public:
+     bool empty() const { return head.load(std::memory_order_relaxed) == nullptr; }
+
+     void push(Thread* thread)
+     {
+         Thread* next = head.load(std::memory_order_relaxed);
+         do {
+             thread->inbox_next = next;
+         } while (!head.compare_exchange_weak(next, thread, std::memory_order_release, std::memory_order_relaxed));
+     }
+
+     Thread* take_all()
+     {
+         // only by the owner. returns the threads oldest first.
+         Thread* thread = head.exchange(nullptr, std::memory_order_acquire);
+         Thread* oldest = nullptr;
+         while (thread != nullptr) {
+             Thread* next = thread->inbox_next;
+             thread->inbox_next = oldest;
+             oldest = thread;
+             thread = next;
+         }
+         return oldest;
+     }
+
+ private:
+     std::atomic<Thread*> head{nullptr};
  };
+
+ // a worker kernel thread of the M:N mode (uthread_init_workers). it runs the threads it takes from its own deque,
+ // or steals from the deques of the others, and waits on its doorbell in its idle loop when there is none.
+ struct Worker {
+     int index;
+     pthread_t pthread;
+     WorkDeque ready;            // the READY threads this worker made READY (it runs them, unless another worker steals them)
+     Inbox inbox;                // the threads other workers made READY on this one, moved to the deque by this worker
+     int doorbell;               // eventfd the idle loop waits on
+     std::atomic<bool> idle{false}; // true while the idle loop may wait on the doorbell (cleared by the one that rings it)
+     Context idle_env;           // context of the idle loop
+     ThreadQueue pinned;         // the READY threads that may not run on every worker (never stolen - only this worker takes them)
+     std::atomic<int> pinned_size{0}; // size of pinned, for the other workers
+     bool pinned_turn = false;   // true if the next thread is taken from pinned, when both it and the deque have one
+     int balance_countdown = BALANCE_QUANTUMS; // quantums of this worker until it balances its READY threads
+ };
+
+ bool wakes_up_before(const Thread* a, const Thread* b)
+ {
+     // order of the sleeping heap - the first to wake up, and the lower tid between threads that wake up together.
+     return a->wake_up_quantum < b->wake_up_quantum || (a->wake_up_quantum == b->wake_up_quantum && a->tid < b->tid);
+ }
  
+ bool runs_before_fair(const Thread* a, const Thread* b)
+ {
+     // order of the ready heap of UTHREAD_SCHED_FAIR - the smallest vruntime, and the lower tid between equal ones.
+     return a->vruntime < b->vruntime || (a->vruntime == b->vruntime && a->tid < b->tid);
+ }
+
+ bool runs_before_edf(const Thread* a, const Thread* b)
+ {
+     // order of the ready heap of UTHREAD_SCHED_EDF - the nearest deadline, and the lower tid between equal ones.
+     return a->absolute_deadline < b->absolute_deadline ||
+            (a->absolute_deadline == b->absolute_deadline && a->tid < b->tid);
+ }
+
+ bool runs_before_stride(const Thread* a, const Thread* b)
+ {
+     // order of the ready heap of UTHREAD_SCHED_STRIDE - the lowest pass, and the lower tid between equal ones.
+     return a->pass < b->pass || (a->pass == b->pass && a->tid < b->tid);
+ }
+
  static struct itimerval timer;                  // timer object for all the threads
- static std::list<Thread*> unblocked_threads;    // double-linkedList for the UNBLOCKED threads. the first one (front) will be the running.
- static std::list<Thread*> blocked_threads;      // double-linkedList for the BLOCKED threads
- static sigset_t sigvtalrm_set;                  // signals-set for storing the ITIMER signal, for blocking when calling a library function
+ // the state of a worker is thread_local (with a single kernel thread, its only worker is the main kernel thread).
+ // it is accessed directly through %fs, so a thread that moved to another worker in a switch uses the state of the new one.
+ static thread_local Thread *running_thread;    // the RUNNING thread. it is not in any queue while it runs
+ static int sched_policy = UTHREAD_SCHED_RR;     // the policy that orders the READY threads
+ static ThreadQueue ready_threads;               // the READY threads for UTHREAD_SCHED_RR, the front runs next
+ static LevelQueues priority_threads;            // the READY threads for UTHREAD_SCHED_PRIORITY, by priority
+ static LevelQueues mlfq_threads;                // the READY threads for UTHREAD_SCHED_MLFQ, level 0 in the highest queue
+ static int mlfq_epoch = 0;                      // incremented by every boost, so the levels of all the threads are reset in O(1)
+ static int mlfq_next_boost = UTHREAD_MLFQ_BOOST_QUANTUMS; // total_quantums of the next boost
+ static ThreadHeap fair_threads(&runs_before_fair); // the READY threads for UTHREAD_SCHED_FAIR, the smallest vruntime on top
+ static long long fair_min_vruntime = 0;         // never decreasing lower bound of the vruntimes, for placing new and woken threads
+ static long long fair_switch_ns = 0;            // CPU time (ns) of the last switch, the running thread is charged from it
+ static ThreadHeap edf_threads(&runs_before_edf); // the READY deadline threads for UTHREAD_SCHED_EDF (the others are in ready_threads)
+ static ThreadHeap stride_threads(&runs_before_stride); // the READY threads for UTHREAD_SCHED_STRIDE, the lowest pass on top
+ static long long stride_global_pass = 0;        // never decreasing pass of the scheduler (the pass of the last picked thread)
+ static ThreadQueue blocked_threads;             // queue of the BLOCKED threads
+ static std::vector<std::atomic<Thread*>> thread_table; // tid -> thread (nullptr for unused tid), for finding a thread in O(1) (without the lock)
+ static ThreadHeap sleeping_threads(&wakes_up_before); // the sleeping threads (also in blocked_threads), the next to wake up on top
+ static std::atomic<int> next_wake_up(INT_MAX);  // wake_up_quantum of the top of sleeping_threads, so the workers check it without the lock
+ static thread_local volatile sig_atomic_t in_library = 0;       // true while inside a library function (critical section). the sig-handler only defers the preemption then
+ static thread_local volatile sig_atomic_t preempt_pending = 0;  // true if the quantum ended inside a library function, and the preemption waits for leave_library
+ static thread_local volatile sig_atomic_t quantum_expired = 0;  // true if the running thread used its whole quantum (the timer fired)
+ static thread_local volatile sig_atomic_t timer_armed = 0;      // true if the timer runs (it is one shot, so it stops when it fires)
+ static thread_local volatile sig_atomic_t timer_signal_masked = 0; // true while SIGVTALRM is blocked for this kernel thread (see mask_timer_signal)
+ static bool tickless = false;                   // true if the timer is stopped while there is nothing to preempt to
+ static int timer_backend = UTHREAD_TIMER_ITIMER; // the timer that ends the quantums
+ static thread_local timer_t posix_timer;       // the timer of the UTHREAD_TIMER_CPUTIME/MONOTONIC backends (every worker has its own)
+ static clockid_t posix_timer_clock;             // and its clock
+ static thread_local long long timer_deadline_ns = 0;         // absolute expiry the posix timer was armed to (on posix_timer_clock)
+ static thread_local volatile sig_atomic_t timer_fired = 0;   // true if the timer fired since it was armed, so the next quantum starts at its expiry
+ static std::atomic<long long> timer_expirations(0);   // jitter stats of the posix timer: number of expirations,
+ static std::atomic<long long> timer_jitter_sum_ns(0); // the sum of their delays from timer_deadline_ns to the sig-handler,
+ static std::atomic<long long> timer_jitter_max_ns(0); // and the longest delay
  
- static std::set<int> unused_tid;                // set of unused_tid, so when a new thread is adding when there was already 
-                                                 // other thread that had terminated, it will get his value. (note - the set is sorted from min to max)
+ static TidAllocator unused_tid;                 // bitmap of the unused tids, so when a new thread is adding when there was already 
+                                                 // other thread that had terminated, it will get his value (the lowest one is taken).
  
  static int quantum_per_thread;                  // global value (init in the init-function) for the sig-handler to use
+ static int max_threads;                         // maximal number of concurrent threads (MAX_THREAD_NUM, or the one given to uthread_init_ex)
 
- static int total_quantums = 0;                  // the total quantums that had been passed since uthreads_init
- static Thread *remove_thread;                   // thread to delete. created for not deleting thread that currently running and by that accsessing unvalid memory.
- static sigjmp_buf exit_env;                     // exit env for terminate the program. created for dealing with terminte(0) by thread with tid != 0.
+ static std::atomic<int> total_quantums(0);      // the total quantums that had been passed since uthreads_init (by all the workers)
+ static int live_threads = 0;                    // number of threads with a tid (the main thread included)
+ static ThreadPool thread_pool;                  // the free Thread control blocks, for spawning without the heap
+ static StackPool stack_pool;                    // the free thread stacks, for spawning without mmap
+ static thread_local Thread *remove_thread;     // thread to release to the pool. created for not deleting thread that currently running and by that accsessing unvalid memory.
+ static Context exit_env;                        // exit env for terminate the program. created for dealing with terminte(0) by thread with tid != 0.
+                                                 // it runs on a stack of its own from the stack pool (with a guard page), so the threads can be deleted without running on one of them
+
+ static Worker *workers = nullptr;               // the workers of the M:N mode (nullptr with a single kernel thread)
+ static int num_workers = 1;                     // and their number
+ static int spawn_worker = 0;                    // the worker the next spawned thread starts on (round-robin)
+ static std::atomic_flag library_lock = ATOMIC_FLAG_INIT; // with workers, guards the shared data (all but the deques and the state of the workers)
+ static thread_local Worker *self_worker;        // the worker of this kernel thread (nullptr with a single kernel thread)
+ static thread_local Thread *parked_thread;      // with workers, the thread this worker switched away from - put away by finish_switch once its context is saved
  
   // ------------------------------------------------------------------------- //
-  
- 
+
+
+// --- context switching (x86-64, System V ABI) --- //
+// switch_context(from, to): saves the callee-saved registers, sp and the return address into 'from' and loads 'to'.
+//                           returns (into the caller of the switch that saved 'from') when some thread switches back.
+// jump_context(to):         loads 'to' without saving anything, for a thread that will never run again.
+// no signal mask is saved or restored, so unlike sigsetjmp/siglongjmp a switch does not make any syscall.
+// a switch is always done inside the critical section, and the thread switched to is the one that leaves it.
+extern "C" void uthreads_switch_context(Context* from, const Context* to);
+extern "C" void uthreads_jump_context(const Context* to) __attribute__((noreturn));
+asm(R"(
+    .text
+    .p2align 4
+    .globl uthreads_switch_context
+    .hidden uthreads_switch_context
+    .type uthreads_switch_context, @function
+uthreads_switch_context:
+    movq %rbx, 0(%rdi)
+    movq %rbp, 8(%rdi)
+    movq %r12, 16(%rdi)
+    movq %r13, 24(%rdi)
+    movq %r14, 32(%rdi)
+    movq %r15, 40(%rdi)
+    leaq 8(%rsp), %rax
+    movq %rax, 48(%rdi)
+    movq (%rsp), %rax
+    movq %rax, 56(%rdi)
+    movq %rsi, %rdi
+    .globl uthreads_jump_context
+    .hidden uthreads_jump_context
+    .type uthreads_jump_context, @function
+uthreads_jump_context:
+    movq 0(%rdi), %rbx
+    movq 8(%rdi), %rbp
+    movq 16(%rdi), %r12
+    movq 24(%rdi), %r13
+    movq 32(%rdi), %r14
+    movq 40(%rdi), %r15
+    movq 48(%rdi), %rsp
+    jmpq *56(%rdi)
+    .size uthreads_switch_context, .-uthreads_switch_context
+)");
  
  
 void print_error(const std::string& msg, PrintType type) 
@@ -72,361 +809,2408 @@ void print_error(const std::string& msg, PrintType type)
 }
  
  
-void start_timer()
+void lock_library()
 {
-    timer.it_interval.tv_sec = 0;
-    timer.it_interval.tv_usec = 0;               // config the timer for one shot
-    
-    timer.it_value.tv_sec = quantum_per_thread / 1000000;
-    timer.it_value.tv_usec = quantum_per_thread % 1000000;
-    if(setitimer(ITIMER_VIRTUAL, &timer, NULL) != 0){ // check if restarting the timer had faild
-        print_error("setitimer failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+    // with workers, taking the lock of the shared data. always inside the critical section, so the sig-handler never
+    // spins on a lock its own worker holds. without workers there is nothing to guard against.
+    if (workers == nullptr) {
+        return;
+    }
+    for (int spins = 0; library_lock.test_and_set(std::memory_order_acquire); spins++) {
+        if (spins < LOCK_SPINS) {
+            asm volatile("pause");
+        } else {
+            sched_yield(); // the holder may be a worker the kernel is not running now
+        }
     }
 }
- 
- 
 
-void wakeup_sleeping_threads()
+void unlock_library()
 {
-    // Wake up any sleeping threads
+    if (workers != nullptr) {
+        library_lock.clear(std::memory_order_release);
+    }
+}
 
-    for (auto thread_itr = blocked_threads.begin(); thread_itr != blocked_threads.end(); ) {
-        if ((*thread_itr)->wake_up_quantum <= total_quantums && (*thread_itr)->sleeping && !(*thread_itr)->blocked) {
-            Thread* thread_ptr = *thread_itr;
-            unblocked_threads.push_back(thread_ptr);
-            thread_itr = blocked_threads.erase(thread_itr);
-        }
-        thread_itr++;
+bool workers_unsupported(const char* function)
+{
+    // the policies other than UTHREAD_SCHED_RR, and the features that need all the threads on one kernel thread, are
+    // not supported with workers. prints the error and returns true for them.
+    if (workers == nullptr) {
+        return false;
     }
+    print_error(std::string(function) + ": not supported with workers", PrintType::THREAD_LIB_ERR);
+    return true;
 }
 
+void sleeping_changed()
+{
+    // updating next_wake_up after sleeping_threads changed
+    next_wake_up = sleeping_threads.empty() ? INT_MAX : sleeping_threads.top()->wake_up_quantum;
+}
 
- 
-address_t translate_address(address_t addr)
+Thread* find_thread(int tid)
 {
-    // 'black-box' given in the examples
-    address_t ret;
-    asm volatile("xor    %%fs:0x30,%0\n"
-        "rol    $0x11,%0\n"
-                : "=g" (ret)
-                : "0" (addr));
-    return ret;
+    // find thread based on tid, in O(1). return nullptr if there is no thread with this tid.
+    // the table is atomic, so with workers it can be read without the lock.
+    if (tid < 0 || tid >= max_threads) {
+        return nullptr;
+    }
+    return thread_table[tid].load(std::memory_order_acquire);
 }
- 
-void setup_thread(char* stack, thread_entry_point entry_point, sigjmp_buf& env)
+
+Thread* create_thread(int tid, thread_entry_point entry_point, ThreadState state)
 {
-    // setup thread like in the example
-    address_t sp = (address_t) stack + STACK_SIZE - sizeof(address_t);
-    address_t pc = (address_t) entry_point;
-    sigsetjmp(env, 1);
-    (env->__jmpbuf)[JB_SP] = translate_address(sp);
-    (env->__jmpbuf)[JB_PC] = translate_address(pc);
-    sigemptyset(&env->__saved_mask);
+    // taking a thread from the pool, with all of its fields zeroed, and setting the given ones.
+    Thread *thread = thread_pool.take();
+    thread->tid = tid;
+    thread->env = Context{};
+    thread->stack = nullptr;
+    thread->stack_size = 0;
+    thread->stack_lazy = false;
+    thread->entry_point = entry_point;
+    thread->wake_up_quantum = 0;
+    thread->quantom_count = 0;
+    thread->quantum_usecs = 0;
+    thread->blocked = false;
+    thread->killed = false;
+    thread->sleeping = false;
+    thread->state = state;
+    thread->worker = 0;
+    thread->parked = false;
+    thread->inbox_next = nullptr;
+    thread->affinity = UTHREAD_AFFINITY_ALL;
+    thread->wait_queue = nullptr;
+    thread->in_handler = false;
+    thread->priority = UTHREAD_PRIORITY_DEFAULT;
+    thread->mlfq_level = 0;
+    thread->mlfq_epoch = mlfq_epoch;
+    thread->weight = UTHREAD_WEIGHT_DEFAULT;
+    thread->vruntime = fair_min_vruntime;
+    thread->period = 0;
+    thread->relative_deadline = 0;
+    thread->absolute_deadline = 0;
+    thread->next_release = 0;
+    thread->deadline_misses = 0;
+    thread->tickets = UTHREAD_TICKETS_DEFAULT;
+    thread->stride = STRIDE_ONE / UTHREAD_TICKETS_DEFAULT;
+    thread->pass = stride_global_pass;
+    thread->next = thread->prev = nullptr;
+    thread->heap_index = -1;
+    return thread;
 }
-  
- 
- void init_itimer_sigset()
- {
-     // initialize the sigset that will used for blocking the itimer signal when entering library functions.
-     if (sigemptyset(&sigvtalrm_set) < 0) {
-         print_error("sigemptyset failed", PrintType::SYSTEM_ERR);
-     }
-     if (sigaddset(&sigvtalrm_set, SIGVTALRM) < 0) {
-         print_error("sigaddset failed", PrintType::SYSTEM_ERR);
-     }
- }
- 
-void block_timer_signal()
+
+void release_thread(Thread* thread)
 {
-    // blocking itimer signal for allowing the current thread to use the library function and not getting undefined behavior
-    if (sigprocmask(SIG_BLOCK, &sigvtalrm_set, nullptr) < 0) {
-        print_error("sigprocmask block failed", PrintType::SYSTEM_ERR);
+    // returning a terminated thread and its stack to the pools. must not be the thread that is running.
+    if (thread->stack != nullptr) {
+        stack_pool.release(thread->stack, thread->stack_size, thread->stack_lazy);
     }
+    thread_pool.release(thread);
+}
+
+void push_to_list(ThreadQueue& lst, Thread* thread, ThreadState state)
+{
+    // adding the thread to the end of lst, and updating its state to match.
+    lst.push_back(thread);
+    thread->state = state;
 }
 
-void unblock_timer_signal()
+int mlfq_level(Thread* thread)
 {
-    // unblocking (only used after blocking)
-    if (sigprocmask(SIG_UNBLOCK, &sigvtalrm_set, nullptr) < 0) {
-        print_error("sigprocmask unblock failed", PrintType::SYSTEM_ERR);
+    // the MLFQ level of the thread, after the boosts since it was last updated (they all move it to level 0).
+    if (thread->mlfq_epoch != mlfq_epoch) {
+        thread->mlfq_epoch = mlfq_epoch;
+        thread->mlfq_level = 0;
     }
+    return thread->mlfq_level;
 }
 
-void pre_jumping() 
+int mlfq_queue(Thread* thread)
 {
-    // putting together all the mendatory action before jumping to a new thread
-    total_quantums++;
-    unblocked_threads.front()->quantom_count++;
-    wakeup_sleeping_threads();
-    start_timer();
+    // the queue of the level in mlfq_threads - the top level is the highest queue.
+    return LevelQueues::LEVELS - 1 - mlfq_level(thread);
 }
- 
 
-void end_of_quantum(int sig){    
-    if(remove_thread != nullptr){
-        delete remove_thread;
-        remove_thread = nullptr;
+void mlfq_boost_if_due()
+{
+    // moving every thread to the top level, so the threads that used their quanta can't starve. the READY ones are
+    // merged into the top queue, and the levels of all the others are reset lazily by the new epoch.
+    if (total_quantums < mlfq_next_boost) {
+        return;
     }
-    wakeup_sleeping_threads();
+    mlfq_next_boost = total_quantums + UTHREAD_MLFQ_BOOST_QUANTUMS;
+    mlfq_epoch++;
+    mlfq_threads.merge_into(LevelQueues::LEVELS - 1);
+}
 
-    Thread *prev_run = unblocked_threads.front();
-    if (unblocked_threads.size() > 1){ // if there is another ready thread
-        unblocked_threads.push_back(unblocked_threads.front()); // pushing the thread to the end of the list
-        unblocked_threads.pop_front(); // removing the thread from the list
+void mlfq_quantum_end(Thread* thread, bool expired)
+{
+    // the thread gives up the CPU: a thread that used its whole quantum moves down a level (with a longer quantum),
+    // and a thread that blocks or sleeps before that moves up one.
+    if (sched_policy != UTHREAD_SCHED_MLFQ) {
+        return;
     }
-
-    if (sigsetjmp(prev_run->env, 1) == 0){
-        total_quantums++;
-        unblocked_threads.front()->quantom_count++;
-        start_timer();
-        siglongjmp(unblocked_threads.front()->env, 1); // jumping to the thread's context
+    int level = mlfq_level(thread);
+    if (expired && level < UTHREAD_MLFQ_LEVELS - 1) {
+        thread->mlfq_level = level + 1;
+    } else if (!expired && level > 0) {
+        thread->mlfq_level = level - 1;
     }
-    return;
 }
-void terminate_program(){
-    // terminate the program when terminte function called with tid==0. deleting all the Threads, because they are on the heap.
-    for (Thread* t : blocked_threads) {
-        delete t;        
-    }
 
-    blocked_threads.clear();
-
-    for (Thread* t : unblocked_threads) {
-        delete t;
+long long clock_ns(clockid_t clock)
+{
+    struct timespec now;
+    if (clock_gettime(clock, &now) != 0) {
+        print_error("clock_gettime failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
     }
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
 
-    unblocked_threads.clear();
-    exit(0);
+long long cpu_time_ns()
+{
+    // CPU time used by the process so far. all the threads run on the same kernel thread, so it is its CPU clock.
+    return clock_ns(CLOCK_THREAD_CPUTIME_ID);
 }
 
-int uthread_init(int quantum_usecs) 
+void fair_charge_running_thread()
 {
-    // Function flow: checking input, init sigset and quantum-global, create main thread, updaiting sig-hangler, updaiting itimer.
-    if (quantum_usecs <= 0) { 
-        print_error("uthread_init: quantum_usecs must be positive", PrintType::THREAD_LIB_ERR);
-        return -1;
+    // adding the CPU time the running thread used since the last switch to its vruntime, scaled by its weight.
+    // called before every switch from the running thread, so the next one is charged from now.
+    if (sched_policy != UTHREAD_SCHED_FAIR) {
+        return;
     }
+    long long now = cpu_time_ns();
+    running_thread->vruntime += (now - fair_switch_ns) * UTHREAD_WEIGHT_DEFAULT / running_thread->weight;
+    fair_switch_ns = now;
+}
 
-    init_itimer_sigset(); // init the sigset for later blocking and unblocking the itimer-signal
-    for (int i = 1; i < MAX_THREAD_NUM; ++i) { // init the unuset_tid (like a basket of all the 'free-tid' numbers). the 0 tid is already using
-        unused_tid.insert(i);
-    }
-    if(sigsetjmp(exit_env, 1) != 0){ // if we are in the exit_env, we need to terminate the program. created for dealing with threads != 0 that wants to terminate the program - so need to delete all the threads while not deleting the current stack
-        terminate_program();
+void charge_running_thread()
+{
+    // charging the running thread for its quantum, by the current policy. called before every switch from it.
+    fair_charge_running_thread();
+    if (sched_policy == UTHREAD_SCHED_STRIDE) {
+        running_thread->pass += running_thread->stride; // a whole stride for every quantum it started
     }
-    quantum_per_thread = quantum_usecs; // updaiting for the sig-handler to use
-    unblocked_threads.push_front(new Thread{0, {}, {}, 0, 0, false, false}); // initializing main thread
-    if(sigsetjmp(unblocked_threads.front()->env, 1) == 0){ // Save current CPU context // TODO - this line needs checking. maybe needs to setjmp later.
+}
 
-        // create and update the sig-handler
-        struct sigaction sa = {0};
-        sa.sa_handler = &end_of_quantum;
-        if (sigaction(SIGVTALRM, &sa, NULL) < 0)
-        {
-            print_error("uthread_init: sigaction failed", PrintType::SYSTEM_ERR); // TODO: make sure this is the type of error
+void ring_doorbell(Worker& worker)
+{
+    // waking up the worker if it waits in its idle loop. the fence pairs with the one in the idle loop: either the
+    // worker sees the new thread when it looks once more before waiting, or this sees it idle.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker.idle.load(std::memory_order_relaxed) && worker.idle.exchange(false)) {
+        uint64_t ring = 1;
+        if (write(worker.doorbell, &ring, sizeof(ring)) < 0) {
+            print_error("write to the doorbell failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
         }
-        pre_jumping();
     }
-    return 0;
 }
- 
- 
-int uthread_spawn(thread_entry_point entry_point){
-    // Function flow: block itimer-signal, checking MAX_THREADS and input, updaiting new tid, create and update the new thread, unblock itimer-signal
-    block_timer_signal();
 
-    int num_threads = unblocked_threads.size() + blocked_threads.size();
-    if(num_threads >= MAX_THREAD_NUM) { // check if the number of threads is already at the maximum 
-        print_error("uthread_spawn: reached maximum number of threads", PrintType::THREAD_LIB_ERR);
-        return -1;
-    }
-    else if(!entry_point){ // check if entry_point is null
-        print_error("uthread_spawn: entry_point is null", PrintType::THREAD_LIB_ERR);
-        return -1;
-    }
-    
-    int tid = *unused_tid.begin(); // get the smallest TID
-    unused_tid.erase(unused_tid.begin()); // remove it from the set
+unsigned long long all_workers_mask()
+{
+    return num_workers == UTHREAD_MAX_WORKERS ? UTHREAD_AFFINITY_ALL : (1ULL << num_workers) - 1;
+}
 
-    Thread *new_thread = new Thread{tid, {}, {}, 0, 0, false, false}; // create new thread
-    setup_thread(new_thread->stack, entry_point, new_thread->env); // setup the new thread
-    unblocked_threads.push_back(new_thread); // add the new thread to the ready threads list
-    
-    unblock_timer_signal();
-    return new_thread->tid;
+bool may_run_on(const Thread* thread, int worker)
+{
+    return (thread->affinity.load(std::memory_order_relaxed) >> worker) & 1;
 }
 
+bool is_pinned(const Thread* thread)
+{
+    // true if the thread may not run on some of the workers - then it is never stolen.
+    return (thread->affinity.load(std::memory_order_relaxed) & all_workers_mask()) != all_workers_mask();
+}
 
+int worker_load(const Worker& worker)
+{
+    // the READY threads of the worker: in its deque, and pinned to it (without its inbox, which it empties soon).
+    return (int)worker.ready.size() + worker.pinned_size.load(std::memory_order_relaxed);
+}
 
- 
- 
- 
-std::list<Thread*>::iterator find_thread_in_list(std::list<Thread*>& lst, int wanted_tid) {
-    // find thread based on tid. on success, return the iterator that points to the thread. on fail return lst.end().
-    for (auto it = lst.begin(); it != lst.end(); ++it) {
-        if ((*it)->tid == wanted_tid) {
-            return it;  // found
+int pick_worker(const Thread* thread)
+{
+    // the worker to make the thread READY on: the one it ran on last if it may still run there, and otherwise the
+    // least loaded worker it may run on.
+    if (may_run_on(thread, thread->worker)) {
+        return thread->worker;
+    }
+    int best = -1;
+    int best_load = INT_MAX;
+    for (int i = 0; i < num_workers; i++) {
+        if (may_run_on(thread, i)) {
+            int load = worker_load(workers[i]) + !workers[i].idle.load(std::memory_order_relaxed);
+            if (load < best_load) {
+                best = i;
+                best_load = load;
+            }
         }
     }
-    return lst.end();  // not found
+    return best;
 }
- 
-Thread* delete_from_list(std::list<Thread*>& lst, int tid){
-    //delete the wanted thread based on the tid, from the lst. return 0 if succseeded (the thread in the lst) and -1 on fail.
-    auto thread_itr = find_thread_in_list(lst, tid);
-    Thread *res = nullptr;
-    if(thread_itr != lst.end()){
-        res = (*thread_itr);
-        lst.erase(thread_itr);
+
+void wake_idle_worker()
+{
+    // waking up one idle worker (if there is one), to steal from a worker that has more READY threads than it can run.
+    for (int i = 1; i < num_workers; i++) {
+        Worker& worker = workers[(self_worker->index + i) % num_workers];
+        if (worker.idle.load(std::memory_order_relaxed)) {
+            ring_doorbell(worker);
+            return;
+        }
     }
-    return res;
 }
 
-int uthread_terminate(int tid){
-
-    // Function flow: check if tid==0 for terminating the whole program. checking if tid is the tid of the running thread (requare more updates).
-    //                   trying to delte the thread fits to the tid from the lists of theads. if not succseeded, means that the tid is not valid.
-
-    block_timer_signal();
-    if(remove_thread != nullptr){
-        delete remove_thread;
-        remove_thread = nullptr;
+size_t ready_size()
+{
+    if (workers != nullptr) {
+        size_t size = 0;
+        for (int i = 0; i < num_workers; i++) {
+            size += workers[i].ready.size();
+        }
+        return size;
     }
-    if(tid == 0){
-        siglongjmp(exit_env, 1);
+    if (sched_policy == UTHREAD_SCHED_PRIORITY) {
+        return priority_threads.size();
     }
-
-    if(tid == unblocked_threads.front()->tid){
-        // -- change the runnign thread to the next ready -- //
-        remove_thread = unblocked_threads.front();
-        unused_tid.insert(remove_thread->tid); // adding the tid of the terminated thread to the unused.
-        unblocked_threads.pop_front(); // it is gurenteed (writen in the forum) that the main thread will not be blocked. so, if tid != 0 and we got here then the list.size>2.
-    
-        
-        // -- update teh total quantums, wake up sleeping threads, and start the timer for the new running thread.
-        pre_jumping();
-        unblock_timer_signal();
-        siglongjmp(unblocked_threads.front()->env, 1); // the function not return, moving to the next thread.
+    if (sched_policy == UTHREAD_SCHED_MLFQ) {
+        return mlfq_threads.size();
     }
-    else{
-        Thread *in_blocked = delete_from_list(blocked_threads, tid);
-        Thread *in_unblocked = delete_from_list(unblocked_threads, tid);
-        remove_thread = (in_blocked != nullptr) ? in_blocked : in_unblocked;
-        if(remove_thread == nullptr){
-            unblock_timer_signal();
-            return -1;
+    if (sched_policy == UTHREAD_SCHED_FAIR) {
+        return fair_threads.size();
+    }
+    if (sched_policy == UTHREAD_SCHED_EDF) {
+        return edf_threads.size() + ready_threads.size();
+    }
+    if (sched_policy == UTHREAD_SCHED_STRIDE) {
+        return stride_threads.size();
+    }
+    return ready_threads.size();
+}
+
+void send_to_worker(Thread* thread);
+
+void ready_push(Thread* thread)
+{
+    // adding the thread to the READY threads of the current policy (at the back of its queue).
+    thread->state = ThreadState::READY;
+    if (workers != nullptr) {
+        if (!may_run_on(thread, self_worker->index)) {
+            thread->worker = pick_worker(thread);
+            send_to_worker(thread);
+        } else if (is_pinned(thread)) {
+            self_worker->pinned.push_back(thread);
+            self_worker->pinned_size.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            self_worker->ready.push(thread);
+            if (self_worker->ready.size() > 1) {
+                wake_idle_worker(); // more than this worker can run next - another one can steal it
+            }
         }
+    } else if (sched_policy == UTHREAD_SCHED_PRIORITY) {
+        priority_threads.push_back(thread, thread->priority);
+    } else if (sched_policy == UTHREAD_SCHED_MLFQ) {
+        mlfq_threads.push_back(thread, mlfq_queue(thread));
+    } else if (sched_policy == UTHREAD_SCHED_FAIR) {
+        fair_threads.push(thread);
+    } else if (sched_policy == UTHREAD_SCHED_EDF && thread->period > 0) {
+        edf_threads.push(thread);
+    } else if (sched_policy == UTHREAD_SCHED_STRIDE) {
+        stride_threads.push(thread);
+    } else {
+        ready_threads.push_back(thread);
+    }
+}
 
-        unused_tid.insert(remove_thread->tid); // adding the tid of the terminated thread to the unused.
+void ready_remove(Thread* thread)
+{
+    if (sched_policy == UTHREAD_SCHED_PRIORITY) {
+        priority_threads.remove(thread, thread->priority);
+    } else if (sched_policy == UTHREAD_SCHED_MLFQ) {
+        mlfq_threads.remove(thread, mlfq_queue(thread));
+    } else if (sched_policy == UTHREAD_SCHED_FAIR) {
+        fair_threads.remove(thread);
+    } else if (sched_policy == UTHREAD_SCHED_EDF && thread->period > 0) {
+        edf_threads.remove(thread);
+    } else if (sched_policy == UTHREAD_SCHED_STRIDE) {
+        stride_threads.remove(thread);
+    } else {
+        ready_threads.remove(thread);
     }
-    unblock_timer_signal();
-    return 0;
 }
- 
 
-int uthread_block(int tid){
-    block_timer_signal();
-    int ret_val = 0;
-    bool unvalid_tid = unused_tid.find(tid) != unused_tid.end() || tid >= MAX_THREAD_NUM || tid <= 0;
-    if( unvalid_tid){
-        print_error("uthread_block: unvalid tid", PrintType::THREAD_LIB_ERR);
-        ret_val = -1;
+Thread* take_ready_thread();
+
+Thread* ready_pop()
+{
+    // taking the READY thread that runs next. without workers the caller makes sure there is one (see pre_jumping), and
+    // with workers it returns nullptr if there is none.
+    if (workers != nullptr) {
+        return take_ready_thread();
     }
-    
-    else if(unblocked_threads.front()->tid == tid){
-        Thread* thread_ptr = unblocked_threads.front();
-        thread_ptr->blocked = true;
-        blocked_threads.push_back(thread_ptr); // move to the blocked list
-        unblocked_threads.pop_front();          // remove from the ready/running list
-        if(sigsetjmp(thread_ptr->env, 1) == 0){
-            pre_jumping();
-            unblock_timer_signal();
-            siglongjmp(unblocked_threads.front()->env, 1);
-        }
+    if (sched_policy == UTHREAD_SCHED_PRIORITY) {
+        return priority_threads.pop_front();
     }
-    else{ // meaning, if the wanted thread is valid and not the running one, need to find it in the unblocked list or do nothing
-        auto thread_itr = find_thread_in_list(unblocked_threads, tid); 
-        if(thread_itr != unblocked_threads.end()){  // if thread not block
-            Thread* thread_ptr = *thread_itr;         
-            thread_ptr->blocked = true;
-            unblocked_threads.erase(thread_itr); // remove from the ready/running list
-            blocked_threads.push_back(thread_ptr);  // move to the blocked list
+    if (sched_policy == UTHREAD_SCHED_MLFQ) {
+        mlfq_boost_if_due();
+        return mlfq_threads.pop_front();
+    }
+    if (sched_policy == UTHREAD_SCHED_FAIR) {
+        Thread* thread = fair_threads.pop();
+        if (thread->vruntime > fair_min_vruntime) {
+            fair_min_vruntime = thread->vruntime;
         }
+        return thread;
     }
-    unblock_timer_signal();
-    return ret_val;
-}
-    
-     
- 
-int uthread_resume(int tid){
-    block_timer_signal();
-    //check for unvalid tid
-    bool unvalid_tid = unused_tid.find(tid) != unused_tid.end() || tid >= MAX_THREAD_NUM || tid < 0;
-    if(unvalid_tid){
-        print_error("uthread_resume: unvalid tid", PrintType::THREAD_LIB_ERR);
-        return -1;
+    if (sched_policy == UTHREAD_SCHED_EDF && !edf_threads.empty()) {
+        return edf_threads.pop(); // the round-robin threads only run when no deadline thread is READY
     }
-    
-    auto thread_itr = find_thread_in_list(blocked_threads, tid); 
-    if(thread_itr != blocked_threads.end()){
-        Thread* thread_ptr = *thread_itr;         // get the pointer
-        thread_ptr->blocked = false;
-        if(!(thread_ptr->sleeping)){
-            blocked_threads.erase(thread_itr);        // remove from the blocked list
-            unblocked_threads.push_back(thread_ptr);  // insert at the back of the ready list
+    if (sched_policy == UTHREAD_SCHED_STRIDE) {
+        Thread* thread = stride_threads.pop();
+        if (thread->pass > stride_global_pass) {
+            stride_global_pass = thread->pass;
         }
-        
+        return thread;
     }
-    unblock_timer_signal();
+    return ready_threads.pop_front();
+}
+
+bool should_preempt(Thread* thread)
+{
+    // true if the policy wants thread to run instead of the running one right away, and not at the end of the quantum.
+    if (running_thread == nullptr) {
+        return false;
+    }
+    if (sched_policy == UTHREAD_SCHED_PRIORITY) {
+        return thread->priority > running_thread->priority;
+    }
+    if (sched_policy == UTHREAD_SCHED_MLFQ) {
+        return mlfq_level(thread) < mlfq_level(running_thread);
+    }
+    if (sched_policy == UTHREAD_SCHED_EDF && thread->period > 0) {
+        return running_thread->period == 0 || runs_before_edf(thread, running_thread);
+    }
+    return false;
+}
+
+void start_timer();
+
+void send_to_worker(Thread* thread)
+{
+    // with workers: making the thread READY on the worker it ran on last (or was spawned on), where its data may still
+    // be in the cache. another worker can't push to that deque, so it puts the thread in the inbox of the worker and
+    // rings its doorbell - no lock and no signal. a thread that may no longer run there goes to another worker.
+    thread->worker = pick_worker(thread);
+    Worker& worker = workers[thread->worker];
+    if (&worker == self_worker) {
+        ready_push(thread);
+        return;
+    }
+    thread->state = ThreadState::READY;
+    worker.inbox.push(thread);
+    ring_doorbell(worker);
+}
+
+void make_ready(Thread* thread)
+{
+    // a thread becomes READY (spawned, resumed or woken up). if it should run before the running thread, the running
+    // thread is preempted when it leaves the critical section.
+    if (workers != nullptr) {
+        send_to_worker(thread);
+        return;
+    }
+    if (sched_policy == UTHREAD_SCHED_FAIR) {
+        // a thread that was away doesn't get all the CPU until it catches up - at most half a quantum of credit
+        long long min_vruntime = fair_min_vruntime - quantum_per_thread * 1000LL / 2;
+        if (thread->vruntime < min_vruntime) {
+            thread->vruntime = min_vruntime;
+        }
+    }
+    if (sched_policy == UTHREAD_SCHED_STRIDE && thread->pass < stride_global_pass) {
+        thread->pass = stride_global_pass; // no credit for the time it was away
+    }
+    ready_push(thread);
+    if (should_preempt(thread)) {
+        preempt_pending = 1;
+    }
+    if (tickless && !timer_armed && running_thread != nullptr) {
+        start_timer(); // the running thread is not alone anymore, so its quantum starts now
+    }
+}
+
+// the wait queue of a synchronization primitive is in the public header (so a mutex can be initialized statically),
+// with the same layout as a ThreadQueue.
+static_assert(sizeof(ThreadQueue) == sizeof(uthread_wait_queue_t) - offsetof(uthread_wait_queue_t, head),
+              "uthread_wait_queue_t must hold a ThreadQueue");
+
+ThreadQueue& waiters(uthread_wait_queue_t* queue)
+{
+    return *reinterpret_cast<ThreadQueue*>(&queue->head);
+}
+
+void lock_wait_queue(uthread_wait_queue_t* queue)
+{
+    // with workers, taking the spinlock of the wait queue, like lock_library (the holder is always inside the
+    // critical section). without workers the critical section is enough.
+    if (workers == nullptr) {
+        return;
+    }
+    for (int spins = 0; __atomic_exchange_n(&queue->lock, 1, __ATOMIC_ACQUIRE) != 0; spins++) {
+        if (spins < LOCK_SPINS) {
+            asm volatile("pause");
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+void unlock_wait_queue(uthread_wait_queue_t* queue)
+{
+    if (workers != nullptr) {
+        __atomic_store_n(&queue->lock, 0, __ATOMIC_RELEASE);
+    }
+}
+
+Thread* take_waiter(uthread_wait_queue_t* queue)
+{
+    // taking the first waiting thread out of the queue (locked by the caller), or nullptr if there is none. it is
+    // made READY by wake_waiter, after the queue is unlocked.
+    // with workers, a terminated thread is skipped (it is released by the worker that puts it away).
+    ThreadQueue& threads = waiters(queue);
+    while (!threads.empty()) {
+        Thread* thread = threads.pop_front();
+        thread->wait_queue = nullptr;
+        if (!thread->killed) {
+            return thread;
+        }
+    }
+    return nullptr;
+}
+
+void leave_wait_queue(Thread* thread)
+{
+    // taking a thread that is terminated out of the wait queue it waits in, if any. with workers, another worker may
+    // take it out first (to wake it up) - then it is not in the queue anymore when the lock is taken.
+    uthread_wait_queue_t* queue = thread->wait_queue;
+    if (queue == nullptr) {
+        return;
+    }
+    lock_wait_queue(queue);
+    if (thread->wait_queue == queue) {
+        waiters(queue).remove(thread);
+        thread->wait_queue = nullptr;
+    }
+    unlock_wait_queue(queue);
+}
+
+void park_thread(Thread* thread)
+{
+    // with workers: leaving a blocked thread that is off the CPU in no list, until uthread_resume makes it READY.
+    // both set a flag and then check the other's (blocked is cleared by uthread_resume before it takes parked), so
+    // at least one of them sees that the thread must be READY, and the exchange lets only one of them do it.
+    thread->state = ThreadState::BLOCKED;
+    thread->parked = true;
+    if (!thread->blocked && thread->wait_queue == nullptr && thread->parked.exchange(false)) {
+        make_ready(thread); // resumed (or woken up from a wait queue) while it was parked
+    }
+}
+
+void unpark_thread(Thread* thread)
+{
+    // with workers: called after clearing blocked or wait_queue of a thread, to make it READY if it is parked and
+    // nothing else keeps it off the CPU. it may have been made READY, run, and parked again since the flag was cleared
+    // (waiting for something else), so the flags are checked only once the exchange gave the thread to this caller -
+    // and if it still can't run, it is parked again.
+    if (thread->parked.exchange(false)) {
+        park_thread(thread);
+    }
+}
+
+void put_away_thread(Thread* thread)
+{
+    // with workers: moving a thread that is off the CPU to where its flags say - it is released if it was terminated,
+    // it goes to the sleeping threads if it sleeps, it is parked if it is blocked or waits in a wait queue, and it goes
+    // to the deque of this worker otherwise. only the terminated and the sleeping ones need the lock.
+    if (thread->killed) {
+        leave_wait_queue(thread); // terminated after it entered a wait queue, before it was parked
+        lock_library();
+        unused_tid.release(thread->tid);
+        thread_table[thread->tid] = nullptr;
+        live_threads--;
+        release_thread(thread);
+        unlock_library();
+    } else if (thread->sleeping) {
+        lock_library();
+        thread->state = ThreadState::BLOCKED;
+        sleeping_threads.push(thread);
+        sleeping_changed();
+        unlock_library();
+    } else if (thread->blocked || thread->wait_queue != nullptr) {
+        park_thread(thread);
+    } else {
+        ready_push(thread);
+    }
+}
+
+bool can_take(Thread* thread)
+{
+    // with workers: true if this worker can run the READY thread it took from a queue. otherwise it puts it away.
+    if (!thread->blocked && !thread->killed && may_run_on(thread, self_worker->index)) {
+        return true;
+    }
+    put_away_thread(thread);
+    return false;
+}
+
+Thread* take_pinned_thread()
+{
+    // with workers: taking the next READY thread pinned to this worker, or nullptr.
+    Worker& self = *self_worker;
+    while (!self.pinned.empty()) {
+        Thread* thread = self.pinned.pop_front();
+        self.pinned_size.fetch_sub(1, std::memory_order_relaxed);
+        if (can_take(thread)) {
+            return thread;
+        }
+    }
+    return nullptr;
+}
+
+Thread* take_ready_thread()
+{
+    // with workers: taking the next READY thread from the deque of this worker (after moving its inbox there), or
+    // stealing one from another worker (from the next one on, so the thieves spread over the victims). the threads
+    // pinned to this worker take turns with its deque. returns nullptr if no worker has one. a thread that was blocked
+    // or terminated while it waited, or that may no longer run here, is put away on the way.
+    Worker& self = *self_worker;
+    for (Thread* thread = self.inbox.take_all(); thread != nullptr; ) {
+        Thread* next = thread->inbox_next;
+        ready_push(thread);
+        thread = next;
+    }
+    self.pinned_turn = !self.pinned_turn;
+    Thread* thread = self.pinned_turn ? take_pinned_thread() : nullptr;
+    if (thread != nullptr) {
+        return thread;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        WorkDeque& deque = workers[(self.index + i) % num_workers].ready;
+        while ((thread = deque.steal()) != nullptr) {
+            if (can_take(thread)) {
+                return thread;
+            }
+        }
+        if (i == 0 && !self.pinned_turn && (thread = take_pinned_thread()) != nullptr) {
+            return thread; // the deque of this worker is empty - its pinned threads come before stealing
+        }
+    }
+    return nullptr;
+}
+
+void remove_from_list(Thread* thread)
+{
+    // removing the thread from the list it is in, based on its state. the RUNNING thread is not in any list.
+    if (thread->wait_queue != nullptr) {
+        leave_wait_queue(thread);
+    } else if (thread->state == ThreadState::BLOCKED) {
+        blocked_threads.remove(thread);
+    } else if (thread->state == ThreadState::READY) {
+        ready_remove(thread);
+    }
+}
+
+void stop_timer()
+{
+    // stopping the timer of the current backend, if it runs.
+    if (!timer_armed) {
+        return;
+    }
+    if (timer_backend == UTHREAD_TIMER_ITIMER) {
+        timer.it_interval.tv_sec = timer.it_interval.tv_usec = 0;
+        timer.it_value.tv_sec = timer.it_value.tv_usec = 0;
+        if(setitimer(ITIMER_VIRTUAL, &timer, NULL) != 0){
+            print_error("setitimer failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+        }
+    } else {
+        struct itimerspec stop = {};
+        if(timer_settime(posix_timer, 0, &stop, NULL) != 0){
+            print_error("timer_settime failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+        }
+    }
+    timer_armed = 0;
+}
+
+void start_posix_timer(long long quantum_ns)
+{
+    // arming the posix timer to an absolute expiry. after the timer fired, the quantum starts at the expiry and not
+    // when the sig-handler got to it, so the delays of the handler don't add up (unless it is already too late).
+    long long now = clock_ns(posix_timer_clock);
+    long long deadline = (timer_fired ? timer_deadline_ns : now) + quantum_ns;
+    if (deadline <= now) {
+        deadline = now + quantum_ns;
+    }
+    struct itimerspec expiry = {};
+    expiry.it_value.tv_sec = deadline / 1000000000LL;
+    expiry.it_value.tv_nsec = deadline % 1000000000LL;
+    timer_deadline_ns = deadline;
+    timer_fired = 0;
+    if(timer_settime(posix_timer, TIMER_ABSTIME, &expiry, NULL) != 0){
+        print_error("timer_settime failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+    }
+}
+
+void start_timer()
+{
+    if (tickless && ready_size() == 0 && sleeping_threads.empty()) {
+        // the running thread is the only one that can run, and no sleeping thread is waiting for the quantums to
+        // pass - there is nothing to preempt to, so the timer is stopped (if it still runs) instead of restarted.
+        stop_timer();
+        return;
+    }
+
+    // the quantum of the running thread
+    long quantum_usecs = running_thread->quantum_usecs != 0 ? running_thread->quantum_usecs : quantum_per_thread;
+    if (sched_policy == UTHREAD_SCHED_MLFQ) {
+        quantum_usecs <<= mlfq_level(running_thread); // the quantum doubles with every level down
+    }
+    if (timer_backend == UTHREAD_TIMER_ITIMER) {
+        timer.it_interval.tv_sec = 0;
+        timer.it_interval.tv_usec = 0;               // config the timer for one shot
+        timer.it_value.tv_sec = quantum_usecs / 1000000;
+        timer.it_value.tv_usec = quantum_usecs % 1000000;
+        if(setitimer(ITIMER_VIRTUAL, &timer, NULL) != 0){ // check if restarting the timer had faild
+            print_error("setitimer failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+        }
+    } else {
+        start_posix_timer(quantum_usecs * 1000LL);
+    }
+    timer_armed = 1;
+}
+ 
+ 
+
+void wakeup_sleeping_threads(int quantum)
+{
+    // Wake up the sleeping threads that their time has come (by 'quantum'). only these threads are touched.
+    // next_wake_up is checked first, so with workers the lock is only taken when some thread is due.
+    if (quantum < next_wake_up) {
+        return;
+    }
+    lock_library();
+    while (!sleeping_threads.empty() && sleeping_threads.top()->wake_up_quantum <= quantum) {
+        Thread* thread_ptr = sleeping_threads.pop();
+        thread_ptr->sleeping = false;
+        if (workers != nullptr) {
+            park_thread(thread_ptr); // READY right away, unless it is blocked as well
+        }
+        else if (!thread_ptr->blocked) {
+            remove_from_list(thread_ptr);
+            make_ready(thread_ptr);
+        }
+    }
+    sleeping_changed();
+    unlock_library();
+}
+
+
+void setup_thread(char* stack, size_t stack_size, void (*start)(void), Context& env)
+{
+    // setup a context that starts running 'start' on top of the given stack.
+    // the sp is aligned like right after a 'call' instruction (16-bytes aligned + return address).
+    address_t sp = (((address_t) stack + stack_size) & ~(address_t) 15) - sizeof(address_t);
+    env = Context{};
+    env.sp = sp;
+    env.pc = (address_t) start;
+}
+  
+ 
+void enter_library()
+{
+    // entering the critical section, so the current thread can use the library data without being preempted in the middle.
+    // no syscall - a SIGVTALRM that fires from now on only marks preempt_pending.
+    in_library = 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+void preempt_running_thread();
+
+void mask_timer_signal(bool masked)
+{
+    // blocking or unblocking SIGVTALRM for this kernel thread. a syscall, so only if it changes.
+    // it must be blocked whenever a thread runs inside the sig-handler, so a new expiry is never delivered on top of
+    // its signal frame (the stack of a thread has room for one): the kernel blocks it when the handler starts, a switch
+    // to a thread that was preempted by the handler blocks it (see run_next_thread), and the return from the handler
+    // unblocks it. a thread that runs outside of the handler unblocks it in leave_library, after a switch from one.
+    if (timer_signal_masked == masked) {
+        return;
+    }
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGVTALRM);
+    if (pthread_sigmask(masked ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL) != 0) {
+        print_error("pthread_sigmask failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+    }
+    timer_signal_masked = masked;
+}
+
+void leave_critical_section(bool in_handler)
+{
+    // leaving the critical section. if the quantum ended inside it, the deferred preemption is done now.
+    // in_library is cleared before checking preempt_pending, so a signal between the two is handled by the sig-handler itself.
+    // in the sig-handler SIGVTALRM is blocked meanwhile, so a new expiry is handled after the handler returns.
+    while (true) {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        in_library = 0;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        if (!preempt_pending) {
+            break;
+        }
+        in_library = 1;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        if (preempt_pending) {
+            preempt_running_thread();
+        }
+    }
+    if (!in_handler) {
+        mask_timer_signal(false); // blocked if a thread inside the sig-handler switched to this one
+    }
+}
+
+void leave_library()
+{
+    leave_critical_section(false);
+}
+
+bool idle_until_wake_up(int fd)
+{
+    // waiting without the CPU until the first sleeping thread should wake up, and counting the quantums that pass in
+    // wall-clock time meanwhile (with workers, only by one of the idle workers - the others see total_quantums change).
+    // the wait ends early if fd (unless it is -1) is readable, or a signal comes. returns true if fd is readable.
+    // called inside the critical section.
+    int start_quantums = total_quantums;
+    long long idle_quantums = (long long) next_wake_up - start_quantums;
+    if (idle_quantums <= 0) {
+        return false;
+    }
+    long long quantum_ns = quantum_per_thread * 1000LL;
+    long long wait_ns = idle_quantums * quantum_ns;
+    struct timespec timeout;
+    timeout.tv_sec = wait_ns / 1000000000LL;
+    timeout.tv_nsec = wait_ns % 1000000000LL;
+    struct pollfd doorbell = {fd, POLLIN, 0};
+    long long start = clock_ns(CLOCK_MONOTONIC);
+    int ready = ppoll(fd >= 0 ? &doorbell : NULL, fd >= 0 ? 1 : 0, &timeout, NULL);
+    if (ready < 0 && errno != EINTR) {
+        print_error("ppoll failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+    }
+    long long passed = (clock_ns(CLOCK_MONOTONIC) - start) / quantum_ns; // less if the wait was cut short
+    total_quantums.compare_exchange_strong(start_quantums, start_quantums + (int) (passed < idle_quantums ? passed : idle_quantums));
+    return ready > 0;
+}
+
+void idle_wait()
+{
+    // without workers, when no thread is READY: stopping the timer and waiting without the CPU until the first sleeping
+    // thread should wake up (counting the quantums that pass), or until a signal if none sleeps. called inside the critical section.
+    stop_timer(); // nothing to preempt to while waiting
+    if (sleeping_threads.empty()) {
+        sigset_t mask;
+        sigprocmask(SIG_SETMASK, NULL, &mask);
+        sigsuspend(&mask); // always returns -1 (EINTR) after a signal was handled
+    } else {
+        idle_until_wake_up(-1);
+    }
+}
+
+void run_next_thread()
+{
+    // the running thread was switched to: a new quantum starts for it. called before the switch.
+    total_quantums++;
+    preempt_pending = 0; // a new quantum starts, so a deferred preemption is not relevant anymore
+    quantum_expired = 0;
+    running_thread->state = ThreadState::RUNNING;
+    running_thread->worker = self_worker != nullptr ? self_worker->index : 0;
+    running_thread->quantom_count++;
+    if (running_thread->in_handler) {
+        mask_timer_signal(true); // it goes on in the sig-handler
+    }
+    start_timer();
+}
+
+void pre_jumping()
+{
+    // putting together all the mendatory action before jumping to a new thread.
+    // the new running thread is the next READY one, unless the caller already set running_thread. with workers there
+    // may be no READY thread - then running_thread stays nullptr, no quantum starts, and the worker goes idle.
+    // without workers, the thread that left the CPU (sleeping, blocked, waiting or terminated) may have been the only
+    // one that could run, even if it was not the main thread (the main thread may wait for a mutex, a condition variable
+    // or a semaphore) - then this waits until a sleeping thread wakes up.
+    wakeup_sleeping_threads(total_quantums + 1); // the ones that wake up in the new quantum
+    if (running_thread == nullptr) {
+        while (workers == nullptr && ready_size() == 0) {
+            idle_wait();
+            wakeup_sleeping_threads(total_quantums + 1);
+        }
+        running_thread = ready_pop();
+        if (running_thread == nullptr) {
+            return;
+        }
+    }
+    run_next_thread();
+}
+
+
+void finish_switch()
+{
+    // with workers, putting away the thread this worker switched away from. it is done only now that its context is
+    // saved, so no other worker can switch to it while it still runs here. called first after every such switch.
+    if (parked_thread != nullptr) {
+        Thread* thread = parked_thread;
+        parked_thread = nullptr;
+        put_away_thread(thread);
+    }
+}
+
+
+void switch_from(Thread* prev)
+{
+    // with workers: switching from prev to the running thread that pre_jumping picked, or to the idle loop of the worker
+    // if there is none. prev is put away after the switch, by its flags. returns when prev runs again.
+    parked_thread = prev;
+    uthreads_switch_context(&prev->env, running_thread != nullptr ? &running_thread->env : &self_worker->idle_env);
+    finish_switch();
+}
+
+
+void worker_idle_loop()
+{
+    // with workers: the loop a worker runs when it has no thread to run, inside the critical section. it takes a READY
+    // thread (its own or stolen) when there is one, and otherwise waits on its doorbell without the CPU, until another
+    // worker sends it a thread or has one to steal. while threads sleep, the wait also ends when the first of them
+    // should wake up - if all the workers are idle, no quantum passes on their timers.
+    while (true) {
+        finish_switch();
+        running_thread = nullptr;
+        pre_jumping();
+        if (running_thread != nullptr) {
+            uthreads_switch_context(&self_worker->idle_env, &running_thread->env); // returns when the worker is idle again
+            continue;
+        }
+        stop_timer(); // nothing to preempt
+        self_worker->idle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with ring_doorbell
+        if (self_worker->inbox.empty() && ready_size() == 0 &&
+            (next_wake_up == INT_MAX || idle_until_wake_up(self_worker->doorbell))) {
+            uint64_t rings;
+            if (read(self_worker->doorbell, &rings, sizeof(rings)) < 0 && errno != EINTR) {
+                print_error("read of the doorbell failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+            }
+        }
+        self_worker->idle.store(false, std::memory_order_relaxed);
+    }
+}
+
+
+void create_worker_timer()
+{
+    // with workers, every worker has its own timer on its own CPU time, and the signal goes to the worker itself.
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGVTALRM;
+    event._sigev_un._tid = gettid();
+    if(timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &posix_timer) != 0){
+        print_error("uthread_init_workers: timer_create failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+    }
+}
+
+
+void* worker_main(void* arg)
+{
+    // the kernel thread of every worker but worker 0 (the main kernel thread). it starts idle, on its own stack.
+    self_worker = (Worker*) arg;
+    create_worker_timer();
+    enter_library();
+    worker_idle_loop(); // never returns
+    return nullptr;
+}
+
+
+void thread_start()
+{
+    // first code of every spawned thread: a thread is always switched to inside the critical section,
+    // so a new thread needs to leave it by itself before running its entry point.
+    finish_switch();
+    leave_library();
+    running_thread->entry_point();
+    uthread_terminate(uthread_get_tid()); // returning from the entry point is like terminating
+}
+ 
+
+void end_of_quantum(int sig){
+    // the sig-handler. the preemption is deferred if the running thread is inside a library function.
+    // the kernel blocks SIGVTALRM while it runs, and its return restores the mask of the interrupted thread.
+    timer_signal_masked = 1;
+    if (timer_backend != UTHREAD_TIMER_ITIMER && timer_armed) {
+        long long jitter = clock_ns(posix_timer_clock) - timer_deadline_ns; // clock_gettime is async-signal-safe
+        timer_expirations++;
+        timer_jitter_sum_ns += jitter;
+        if (jitter > timer_jitter_max_ns) {
+            timer_jitter_max_ns = jitter;
+        }
+        timer_fired = 1;
+    }
+    timer_armed = 0;
+    quantum_expired = 1;
+    if (in_library) {
+        preempt_pending = 1;
+        timer_signal_masked = 0;
+        return;
+    }
+    Thread* thread = running_thread;
+    thread->in_handler = true;
+    enter_library();
+    preempt_running_thread();
+    leave_critical_section(true);
+    thread->in_handler = false;
+    timer_signal_masked = 0;
+}
+
+void release_removed_thread()
+{
+    if(remove_thread != nullptr){
+        lock_library();
+        release_thread(remove_thread);
+        unlock_library();
+        remove_thread = nullptr;
+    }
+}
+
+void move_to_worker(Thread* thread, Worker& worker)
+{
+    thread->worker = worker.index;
+    worker.inbox.push(thread);
+}
+
+void balance_load()
+{
+    // with workers: moving READY threads of this worker to the least loaded one, while this one has at least two more
+    // (with the running threads). stealing only helps a worker that has nothing to run, so this is what evens out two
+    // busy workers. a worker moves only its own threads (so the pinned queues need no lock), and only to workers
+    // they may run on. the pinned threads go first, because no one can steal them.
+    Worker& self = *self_worker;
+    Worker* least = nullptr;
+    int least_load = INT_MAX;
+    for (int i = 1; i < num_workers; i++) {
+        Worker& worker = workers[(self.index + i) % num_workers];
+        int load = worker_load(worker) + !worker.idle.load(std::memory_order_relaxed);
+        if (load < least_load) {
+            least = &worker;
+            least_load = load;
+        }
+    }
+    if (least == nullptr) {
+        return;
+    }
+    int moves = (worker_load(self) + 1 - least_load) / 2;
+    if (moves <= 0) {
+        return;
+    }
+    for (Thread* thread = self.pinned.front(); thread != nullptr && moves > 0; ) {
+        Thread* next = thread->next;
+        if (may_run_on(thread, least->index)) {
+            self.pinned.remove(thread);
+            self.pinned_size.fetch_sub(1, std::memory_order_relaxed);
+            move_to_worker(thread, *least);
+            moves--;
+        }
+        thread = next;
+    }
+    Thread* thread;
+    while (moves > 0 && (thread = self.ready.steal()) != nullptr) {
+        move_to_worker(thread, *least); // a thread in the deque may run on every worker
+        moves--;
+    }
+    ring_doorbell(*least);
+}
+
+void preempt_worker_thread(){
+    // with workers: like preempt_running_thread, but the running thread is put back in the deque only after the switch,
+    // and keeps running if no worker has a READY thread. a thread another worker blocked or terminated while it ran
+    // here, or that may no longer run here, is put away instead.
+    Thread *prev_run = running_thread;
+    if (--self_worker->balance_countdown == 0) {
+        self_worker->balance_countdown = BALANCE_QUANTUMS;
+        balance_load();
+    }
+    if (!prev_run->blocked && !prev_run->killed && may_run_on(prev_run, self_worker->index)) {
+        running_thread = ready_pop();
+        if (running_thread == nullptr) {
+            running_thread = prev_run; // a new quantum of the same thread
+            pre_jumping();
+            return;
+        }
+    } else {
+        running_thread = nullptr;
+    }
+    pre_jumping();
+    switch_from(prev_run); // returns when prev_run runs again
+}
+
+void preempt_running_thread(){
+    // moving the running thread to the end of the READY list and jumping to the next one. called inside the critical section.
+    release_removed_thread();
+    if (workers != nullptr) {
+        preempt_worker_thread();
+        return;
+    }
+    wakeup_sleeping_threads(total_quantums);
+
+    Thread *prev_run = running_thread;
+    charge_running_thread();
+    if (quantum_expired) { // a yield or a preemption by a better thread keeps the level
+        mlfq_quantum_end(prev_run, true);
+    }
+    ready_push(prev_run); // the next one is prev_run itself if there is no other ready thread (or no better one)
+    running_thread = ready_pop();
+    run_next_thread();
+    uthreads_switch_context(&prev_run->env, &running_thread->env); // jumping to the thread's context. returns when prev_run runs again
+}
+void sleep_running_thread(int wake_up_quantum){
+    // moving the running thread to the sleeping threads until wake_up_quantum, and jumping to the next one. called
+    // inside the critical section, and returns after the thread wakes up.
+    Thread *prev_running = running_thread;
+    if (workers != nullptr) {
+        lock_library();
+        prev_running->wake_up_quantum = wake_up_quantum;
+        prev_running->sleeping = true; // moved to the sleeping threads after the switch
+        unlock_library();
+        running_thread = nullptr;
+        pre_jumping();
+        switch_from(prev_running);
+        return;
+    }
+    prev_running->wake_up_quantum = wake_up_quantum;
+    prev_running->sleeping = true;
+    mlfq_quantum_end(prev_running, quantum_expired); // moving up a level, if it sleeps before its quantum ends
+    charge_running_thread();
+    push_to_list(blocked_threads, prev_running, ThreadState::BLOCKED);
+    sleeping_threads.push(prev_running); // and to the sleeping heap, for waking it up on time
+    sleeping_changed();
+    running_thread = nullptr;
+    pre_jumping();
+    uthreads_switch_context(&prev_running->env, &running_thread->env);
+}
+
+
+int mutex_owner_state(const Thread* thread){
+    return (thread->tid + 1) << 1;
+}
+
+void mutex_release(uthread_mutex_t* mutex, int owner_state);
+
+void wait_in_queue(uthread_wait_queue_t* queue, uthread_mutex_t* mutex){
+    // the running thread waits in the queue (locked by the caller, and unlocked here) until wake_waiter makes it READY,
+    // and jumps to the next thread. the mutex (if not nullptr) is unlocked once the thread is in the queue, so a thread
+    // that signals after it took the mutex finds this one there. called inside the critical section, and returns
+    // after the thread is woken up.
+    Thread *prev_running = running_thread;
+    waiters(queue).push_back(prev_running);
+    prev_running->wait_queue = queue;
+    if (workers != nullptr) {
+        unlock_wait_queue(queue); // from here another worker may take it out - it is made READY once it is parked
+        if (mutex != nullptr) {
+            mutex_release(mutex, mutex_owner_state(prev_running));
+        }
+        running_thread = nullptr;
+        pre_jumping();
+        switch_from(prev_running);
+        return;
+    }
+    if (mutex != nullptr) {
+        mutex_release(mutex, mutex_owner_state(prev_running));
+    }
+    mlfq_quantum_end(prev_running, quantum_expired);
+    charge_running_thread();
+    prev_running->state = ThreadState::BLOCKED;
+    running_thread = nullptr;
+    pre_jumping();
+    uthreads_switch_context(&prev_running->env, &running_thread->env);
+}
+
+void wake_waiter(Thread* thread){
+    // making a thread that take_waiter took out of a wait queue READY, unless it was blocked while it waited - then it
+    // stays blocked until uthread_resume. with workers, it is made READY here only if it is parked already (see unpark_thread).
+    if (workers != nullptr) {
+        if (may_run_on(thread, self_worker->index)) {
+            thread->worker = self_worker->index; // what it waited for was just used here, and the switch to it is a user-level one
+        }
+        unpark_thread(thread);
+    } else if (thread->blocked) {
+        push_to_list(blocked_threads, thread, ThreadState::BLOCKED);
+    } else {
+        make_ready(thread);
+    }
+}
+
+void mutex_lock_slow(uthread_mutex_t* mutex, int owner_state){
+    // the mutex is held: spinning a little with workers, then waiting in its wait queue. the waiters bit is set with
+    // the queue locked, so uthread_mutex_unlock of the owner can't miss this thread - it hands the mutex over to it.
+    if (workers != nullptr) {
+        for (int spins = 0; spins < MUTEX_SPINS; spins++) {
+            asm volatile("pause");
+            int state = 0;
+            if (__atomic_load_n(&mutex->state, __ATOMIC_RELAXED) == 0 &&
+                __atomic_compare_exchange_n(&mutex->state, &state, owner_state, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+        }
+    }
+    lock_wait_queue(&mutex->waiters);
+    int state = __atomic_load_n(&mutex->state, __ATOMIC_RELAXED);
+    while (true) {
+        int wanted = state == 0 ? owner_state : state | MUTEX_WAITERS; // it may be unlocked meanwhile
+        if (__atomic_compare_exchange_n(&mutex->state, &state, wanted, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (state == 0) {
+        unlock_wait_queue(&mutex->waiters);
+        return;
+    }
+    wait_in_queue(&mutex->waiters, nullptr); // returns as the owner
+}
+
+void mutex_hand_over(uthread_mutex_t* mutex){
+    // unlocking a mutex threads wait for: the first of them becomes the owner directly, so the mutex is never free in
+    // between, and the others keep waiting (no thundering herd, and no other thread can take it first).
+    lock_wait_queue(&mutex->waiters);
+    Thread* next_owner = take_waiter(&mutex->waiters);
+    int state = 0; // no waiter, if the ones that waited were terminated
+    if (next_owner != nullptr) {
+        state = mutex_owner_state(next_owner) | (waiters(&mutex->waiters).empty() ? 0 : MUTEX_WAITERS);
+    }
+    __atomic_store_n(&mutex->state, state, __ATOMIC_RELEASE);
+    unlock_wait_queue(&mutex->waiters);
+    if (next_owner != nullptr) {
+        wake_waiter(next_owner);
+    }
+}
+
+void mutex_release(uthread_mutex_t* mutex, int owner_state){
+    // unlocking a mutex the running thread holds - with a single CAS if no thread waits for it.
+    if (!__atomic_compare_exchange_n(&mutex->state, &owner_state, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        mutex_hand_over(mutex);
+    }
+}
+
+void mutex_acquire(uthread_mutex_t* mutex, int owner_state){
+    // locking a mutex the running thread doesn't hold - with a single CAS if it is unlocked.
+    int state = 0;
+    if (!__atomic_compare_exchange_n(&mutex->state, &state, owner_state, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        mutex_lock_slow(mutex, owner_state);
+    }
+}
+
+void make_all_ready(ThreadQueue& threads){
+    // without workers: making the threads of a wait queue READY together (their state is set by the caller). under
+    // round-robin they are spliced onto the end of the READY queue in O(1), and the other policies order them one by one.
+    if (sched_policy != UTHREAD_SCHED_RR) {
+        while (!threads.empty()) {
+            make_ready(threads.pop_front());
+        }
+        return;
+    }
+    ready_threads.splice_back(threads);
+    if (tickless && !timer_armed && running_thread != nullptr) {
+        start_timer(); // the running thread is not alone anymore, so its quantum starts now
+    }
+}
+
+void wake_all_waiters(uthread_wait_queue_t* queue){
+    // waking up all the threads of the wait queue. without workers the queue is taken in one step. with workers every
+    // worker has its own deques, so the threads are taken out in batches (into an array, since after the queue is
+    // unlocked their links may be used by the workers that put them away), and go back to their workers one by one
+    // with the queue unlocked. at most as many threads as waited when the broadcast started are taken, so the broadcast
+    // ends even if the woken threads wait again.
+    lock_wait_queue(queue);
+    if (workers != nullptr) {
+        Thread* batch[BROADCAST_BATCH];
+        size_t left = waiters(queue).size();
+        while (true) {
+            int count = 0;
+            Thread* thread;
+            while (count < BROADCAST_BATCH && left > 0 && (thread = take_waiter(queue)) != nullptr) {
+                batch[count++] = thread;
+                left--;
+            }
+            if (count < BROADCAST_BATCH) {
+                left = 0; // the queue is empty
+            }
+            unlock_wait_queue(queue);
+            for (int i = 0; i < count; i++) {
+                unpark_thread(batch[i]);
+            }
+            if (left == 0) {
+                return;
+            }
+            lock_wait_queue(queue);
+        }
+    }
+    ThreadQueue woken;
+    woken.splice_back(waiters(queue));
+    for (Thread* thread = woken.front(); thread != nullptr; ) {
+        Thread* next = thread->next;
+        thread->wait_queue = nullptr;
+        if (thread->blocked) {
+            woken.remove(thread); // stays blocked until uthread_resume
+            push_to_list(blocked_threads, thread, ThreadState::BLOCKED);
+        } else {
+            thread->state = ThreadState::READY;
+        }
+        thread = next;
+    }
+    make_all_ready(woken);
+}
+
+bool sem_try_take(uthread_sem_t* sem){
+    // taking a permit if there is one, with a CAS.
+    int count = __atomic_load_n(&sem->count, __ATOMIC_RELAXED);
+    while (count > 0) {
+        if (__atomic_compare_exchange_n(&sem->count, &count, count - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void terminate_program(){
+    // terminate the program when terminte function called with tid==0. deleting all the Threads, because they are on the heap.
+    // all of them are in the slabs of the pool, so freeing the slabs is enough (after unmapping their stacks).
+    if (remove_thread != nullptr) {
+        release_thread(remove_thread);
+    }
+    for (Thread* thread : thread_table) {
+        if (thread != nullptr && thread->stack != nullptr) {
+            stack_pool.unmap(thread->stack, thread->stack_size, thread->stack_lazy);
+        }
+    }
+    stack_pool.destroy();
+    thread_pool.destroy();
+
+    sleeping_threads.clear();
+    thread_table.clear();
+    exit(0);
+}
+
+int uthread_init(int quantum_usecs) 
+{
+    return uthread_init_ex(quantum_usecs, MAX_THREAD_NUM);
+}
+
+
+int uthread_init_ex(int quantum_usecs, int max_thread_num)
+{
+    // Function flow: checking input, init the thread structures for max_thread_num threads and quantum-global, create main thread, updaiting sig-hangler, updaiting itimer.
+    if (quantum_usecs <= 0) { 
+        print_error("uthread_init: quantum_usecs must be positive", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    if (max_thread_num <= 0) {
+        print_error("uthread_init: max_thread_num must be positive", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+
+    max_threads = max_thread_num;
+    unused_tid.init(max_threads); // init the unuset_tid (like a basket of all the 'free-tid' numbers)
+    unused_tid.allocate(); // the 0 tid is already using by the main thread
+    // the exit_env runs terminate_program on its own stack. created for dealing with threads != 0 that wants to terminate the program - so need to delete all the threads while not deleting the current stack
+    size_t exit_stack_size;
+    char* exit_stack = stack_pool.take(EXIT_STACK_SIZE + SIGNAL_FRAME_SIZE, false, exit_stack_size); // a SIGVTALRM may still land on it
+    if (exit_stack == nullptr) {
+        print_error("uthread_init: mmap of the exit stack failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+    }
+    setup_thread(exit_stack, exit_stack_size, &terminate_program, exit_env);
+    quantum_per_thread = quantum_usecs; // updaiting for the sig-handler to use
+    std::vector<std::atomic<Thread*>> table(max_threads); // all nullptr
+    thread_table.swap(table);
+    sleeping_threads.reserve(max_threads);
+    fair_threads.reserve(max_threads);
+    edf_threads.reserve(max_threads);
+    stride_threads.reserve(max_threads);
+    thread_pool.grow(INITIAL_POOL_SIZE);
+    Thread *main_thread = create_thread(0, nullptr, ThreadState::RUNNING); // initializing main thread. its context is saved on its first switch
+    running_thread = main_thread;
+    thread_table[0] = main_thread;
+    live_threads = 1;
+
+    // create and update the sig-handler
+    struct sigaction sa = {0};
+    sa.sa_handler = &end_of_quantum;
+    sa.sa_flags = 0; // SIGVTALRM is blocked while the handler runs, also after it switches to another thread (see leave_critical_section)
+    if (sigaction(SIGVTALRM, &sa, NULL) < 0)
+    {
+        print_error("uthread_init: sigaction failed", PrintType::SYSTEM_ERR); // TODO: make sure this is the type of error
+    }
+    pre_jumping();
+    return 0;
+}
+ 
+ 
+int uthread_init_workers(int quantum_usecs, int max_thread_num, int worker_count)
+{
+    // Function flow: checking input, init like uthread_init_ex, moving the main kernel thread (worker 0) from the itimer to a timer of its own, starting the other workers.
+    //                they start idle, and steal the READY threads from the deque of worker 0.
+    if (worker_count <= 0 || worker_count > UTHREAD_MAX_WORKERS) {
+        print_error("uthread_init_workers: worker_count out of range", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    if (uthread_init_ex(quantum_usecs, max_thread_num) != 0) {
+        return -1;
+    }
+    enter_library();
+    stop_timer(); // the itimer is of the whole process
+
+    workers = new Worker[worker_count];
+    num_workers = worker_count;
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].index = i;
+        if (!workers[i].ready.init(max_threads)) {
+            print_error("uthread_init_workers: mmap of the deque failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+        }
+        workers[i].doorbell = eventfd(0, EFD_CLOEXEC);
+        if (workers[i].doorbell < 0) {
+            print_error("uthread_init_workers: eventfd failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+        }
+    }
+    self_worker = &workers[0];
+    workers[0].pthread = pthread_self();
+    size_t idle_stack_size;
+    char* idle_stack = stack_pool.take(IDLE_STACK_SIZE + SIGNAL_FRAME_SIZE, false, idle_stack_size);
+    if (idle_stack == nullptr) {
+        print_error("uthread_init_workers: mmap of the stack failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+    }
+    setup_thread(idle_stack, idle_stack_size, &worker_idle_loop, workers[0].idle_env);
+
+    timer_backend = UTHREAD_TIMER_CPUTIME;
+    posix_timer_clock = CLOCK_THREAD_CPUTIME_ID;
+    create_worker_timer();
+    for (int i = 1; i < num_workers; i++) {
+        if (pthread_create(&workers[i].pthread, nullptr, &worker_main, &workers[i]) != 0) {
+            print_error("uthread_init_workers: pthread_create failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+        }
+    }
+    start_timer();
+    leave_library();
+    return 0;
+}
+
+
+int uthread_get_worker(){
+    return running_thread->worker;
+}
+
+
+int uthread_set_affinity(int tid, unsigned long long worker_mask){
+    // Function flow: checking input, enter the critical section, setting the mask. a thread that runs on a worker out of the mask is preempted, and
+    //                moves when its worker puts it away. a READY one moves when a worker takes it, and a blocked or sleeping one when it is made READY.
+    if((worker_mask & all_workers_mask()) == 0){
+        print_error("uthread_set_affinity: no existing worker in the mask", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr){
+        print_error("uthread_set_affinity: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    thread_ptr->affinity = worker_mask & all_workers_mask();
+    if(workers != nullptr && thread_ptr->state == ThreadState::RUNNING && !may_run_on(thread_ptr, thread_ptr->worker)){
+        if(thread_ptr == running_thread){
+            preempt_pending = 1; // preempted when it leaves the critical section
+        } else {
+            pthread_kill(workers[thread_ptr->worker].pthread, SIGVTALRM);
+        }
+    }
+    leave_library();
+    return 0;
+}
+
+
+unsigned long long uthread_get_affinity(int tid){
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_affinity: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return 0;
+    }
+    unsigned long long worker_mask = thread_ptr->affinity & all_workers_mask();
+    leave_library();
+    return worker_mask;
+}
+
+
+int uthread_get_worker_queue_length(int worker){
+    if(worker < 0 || worker >= num_workers){
+        print_error("uthread_get_worker_queue_length: unvalid worker", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    if(workers != nullptr){
+        return worker_load(workers[worker]);
+    }
+    enter_library();
+    int length = (int)ready_size();
+    leave_library();
+    return length;
+}
+
+
+int uthread_attr_init(uthread_attr_t* attr){
+    // Function flow: checking input, setting the defaults.
+    if(attr == nullptr){
+        print_error("uthread_attr_init: null attr", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    attr->stack_size = STACK_SIZE;
+    attr->stack_mode = UTHREAD_STACK_FIXED;
+    attr->priority = UTHREAD_PRIORITY_DEFAULT;
+    attr->quantum_usecs = 0;
+    attr->weight = UTHREAD_WEIGHT_DEFAULT;
+    attr->tickets = UTHREAD_TICKETS_DEFAULT;
+    return 0;
+}
+
+
+int uthread_spawn(thread_entry_point entry_point){
+    return uthread_spawn_ex(entry_point, nullptr);
+}
+
+
+int uthread_spawn_ex(thread_entry_point entry_point, const uthread_attr_t* attr){
+    // Function flow: enter the critical section, checking MAX_THREADS and input, updaiting new tid, create and update the new thread, leave the critical section
+    uthread_attr_t default_attr;
+    if(attr == nullptr){
+        uthread_attr_init(&default_attr);
+        attr = &default_attr;
+    }
+    enter_library();
+    lock_library();
+
+    if(live_threads >= max_threads) { // check if the number of threads is already at the maximum 
+        print_error("uthread_spawn: reached maximum number of threads", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(!entry_point){ // check if entry_point is null
+        print_error("uthread_spawn: entry_point is null", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(attr->stack_size == 0){
+        print_error("uthread_spawn: stack_size must be positive", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(attr->stack_size > StackPool::max_size() - SIGNAL_FRAME_SIZE){
+        print_error("uthread_spawn: stack_size too large", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(attr->stack_mode != UTHREAD_STACK_FIXED && attr->stack_mode != UTHREAD_STACK_LAZY){
+        print_error("uthread_spawn: unknown stack_mode", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(attr->priority < 0 || attr->priority >= UTHREAD_PRIORITY_LEVELS){
+        print_error("uthread_spawn: priority out of range", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(attr->quantum_usecs < 0){
+        print_error("uthread_spawn: quantum_usecs must be non-negative", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(attr->weight <= 0){
+        print_error("uthread_spawn: weight must be positive", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    else if(attr->tickets <= 0 || attr->tickets > UTHREAD_TICKETS_MAX){
+        print_error("uthread_spawn: tickets out of range", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+
+    size_t stack_size;
+    bool stack_lazy = attr->stack_mode == UTHREAD_STACK_LAZY;
+    char *stack = stack_pool.take(attr->stack_size + SIGNAL_FRAME_SIZE, stack_lazy, stack_size); // room for the sig-handler frame as well
+    if(stack == nullptr){ // out of memory or mappings - the process can go on
+        print_error("uthread_spawn: mmap of the stack failed", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+
+    int tid = unused_tid.allocate(); // get the smallest TID and mark it as used
+
+    Thread *new_thread = create_thread(tid, entry_point, ThreadState::READY); // create new thread
+    new_thread->stack = stack;
+    new_thread->stack_size = stack_size;
+    new_thread->stack_lazy = stack_lazy;
+    new_thread->priority = attr->priority;
+    new_thread->quantum_usecs = attr->quantum_usecs;
+    new_thread->weight = attr->weight;
+    new_thread->tickets = attr->tickets;
+    new_thread->stride = STRIDE_ONE / attr->tickets;
+    setup_thread(new_thread->stack, new_thread->stack_size, &thread_start, new_thread->env); // setup the new thread
+    thread_table[tid] = new_thread;
+    live_threads++;
+    if(workers != nullptr){
+        new_thread->worker = spawn_worker; // the new threads are spread over the workers
+        spawn_worker = (spawn_worker + 1) % num_workers;
+    }
+    make_ready(new_thread); // add the new thread to the ready threads list
+    
+    unlock_library();
+    leave_library();
+    return tid;
+}
+
+
+
+ 
+ 
+ 
+
+int uthread_terminate(int tid){
+
+    // Function flow: check if tid==0 for terminating the whole program. checking if tid is the tid of the running thread (requare more updates).
+    //                   trying to delte the thread fits to the tid from the lists of theads. if not succseeded, means that the tid is not valid.
+    //                   with workers, a thread that is READY or runs on another worker is only marked, and it is released (with its tid) by the worker that takes it off the CPU.
+
+    enter_library();
+    release_removed_thread();
+    if(tid == 0 && workers != nullptr){
+        // the other workers still run threads on the library data, so nothing is freed - the process just ends
+        std::fflush(nullptr);
+        _exit(0);
+    }
+    if(tid == 0){
+        stop_timer(); // no new quantum ends while the program terminates
+        uthreads_jump_context(&exit_env);
+    }
+
+    if(tid == running_thread->tid){
+        if(workers != nullptr){
+            Thread* prev_running = running_thread;
+            prev_running->killed = true; // released by finish_switch, when the worker is not on its stack anymore
+            running_thread = nullptr;
+            pre_jumping();
+            switch_from(prev_running); // never returns
+        }
+        // -- change the runnign thread to the next ready -- //
+        remove_thread = running_thread;
+        charge_running_thread();
+        unused_tid.release(remove_thread->tid); // adding the tid of the terminated thread to the unused.
+        thread_table[remove_thread->tid] = nullptr;
+        live_threads--;
+        running_thread = nullptr; // the next READY thread. if there is none (the main thread waits too), pre_jumping waits for a sleeping thread
+
+
+        // -- update teh total quantums, wake up sleeping threads, and start the timer for the new running thread.
+        pre_jumping();
+        uthreads_jump_context(&running_thread->env); // the function not return, moving to the next thread. it leaves the critical section.
+    }
+    else{
+        lock_library();
+        Thread* thread_ptr = find_thread(tid);
+        if(thread_ptr == nullptr){
+            unlock_library();
+            leave_library();
+            return -1;
+        }
+        if(workers != nullptr){
+            // only a thread in the sleeping heap (guarded by the lock) or a parked one is off the CPU for sure. the
+            // exchange takes a parked thread from a uthread_resume that may race with this.
+            bool off_cpu = (thread_ptr->sleeping && thread_ptr->heap_index >= 0) || thread_ptr->parked.exchange(false);
+            if(!off_cpu){
+                thread_ptr->killed = true;
+                if(thread_ptr->state == ThreadState::RUNNING){
+                    pthread_kill(workers[thread_ptr->worker].pthread, SIGVTALRM); // preempting it on its worker right away
+                }
+                unlock_library();
+                leave_library();
+                return 0;
+            }
+        }
+
+        remove_thread = thread_ptr;
+        if(workers == nullptr){
+            remove_from_list(remove_thread); // with workers, the BLOCKED threads are in no list
+        } else {
+            leave_wait_queue(remove_thread); // but the waiting ones are in their wait queue
+        }
+        if(remove_thread->sleeping){
+            sleeping_threads.remove(remove_thread);
+            sleeping_changed();
+        }
+        unused_tid.release(remove_thread->tid); // adding the tid of the terminated thread to the unused.
+        thread_table[remove_thread->tid] = nullptr;
+        live_threads--;
+        unlock_library();
+    }
+    leave_library();
+    return 0;
+}
+ 
+
+int uthread_block(int tid){
+    // with workers, a thread that is READY or runs on another worker is only marked, and it is parked by the worker
+    // that takes it off the CPU. nothing here needs the lock.
+    enter_library();
+    int ret_val = 0;
+    Thread* thread_ptr = find_thread(tid);
+    bool unvalid_tid = thread_ptr == nullptr || tid == 0;
+    if( unvalid_tid){
+        print_error("uthread_block: unvalid tid", PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    
+    else if(thread_ptr == running_thread){
+        thread_ptr->blocked = true;
+        if(workers != nullptr){
+            running_thread = nullptr;
+            pre_jumping();
+            switch_from(thread_ptr); // returns after the thread is resumed
+            leave_library();
+            return 0;
+        }
+        charge_running_thread();
+        mlfq_quantum_end(thread_ptr, quantum_expired);
+        push_to_list(blocked_threads, thread_ptr, ThreadState::BLOCKED); // move to the blocked list
+        running_thread = nullptr;
+        pre_jumping();
+        uthreads_switch_context(&thread_ptr->env, &running_thread->env); // returns after the thread is resumed
+    }
+    else{ // meaning, if the wanted thread is valid and not the running one, need to move it from the unblocked list or just mark it
+        thread_ptr->blocked = true;
+        if(workers != nullptr){
+            if(thread_ptr->state == ThreadState::RUNNING){
+                pthread_kill(workers[thread_ptr->worker].pthread, SIGVTALRM); // preempting it on its worker right away
+            }
+        }
+        else if(thread_ptr->state == ThreadState::READY){  // if thread not block
+            remove_from_list(thread_ptr); // remove from the ready/running list
+            push_to_list(blocked_threads, thread_ptr, ThreadState::BLOCKED);  // move to the blocked list
+        }
+    }
+    leave_library();
+    return ret_val;
+}
+    
+     
+ 
+int uthread_resume(int tid){
+    // with workers, a parked thread is sent to the worker it ran on, without the lock (see unpark_thread). a thread that
+    // was blocked while it ran or was READY is only marked, like a sleeping one.
+    enter_library();
+    //check for unvalid tid
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr){
+        print_error("uthread_resume: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    
+    thread_ptr->blocked = false;
+    if(workers != nullptr){
+        unpark_thread(thread_ptr);
+    }
+    else if(thread_ptr->state == ThreadState::BLOCKED){
+        if(!(thread_ptr->sleeping) && thread_ptr->wait_queue == nullptr){ // a waiting thread is woken up by its wait queue
+            remove_from_list(thread_ptr);        // remove from the blocked list
+            make_ready(thread_ptr);              // insert at the back of the ready list
+        }
+        
+    }
+    leave_library();
+    return 0;
+}
+int uthread_sleep(int num_quantums){
+    enter_library(); // Enter the critical section to prevent interruptions.
+    if(running_thread->tid == 0){ // Ensure the main thread is not trying to sleep.
+        print_error("uthread_sleep: trying to put main thread to sleep", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    sleep_running_thread(total_quantums + num_quantums - 1); // Switch to the next thread, returns after waking up.
+    leave_library(); // Leave the critical section after execution.
+    return 0;
+}
+ 
+int uthread_get_tid(){
+    return running_thread->tid; // Return the ID of the currently running thread.
+}
+    
+int uthread_get_total_quantums(){
+    return total_quantums; // Return the total number of quantums since initialization.
+}
+    
+int uthread_get_quantums(int tid){
+    enter_library(); // Enter the critical section to prevent interruptions.
+    lock_library();
+    Thread* thread_ptr = find_thread(tid); // Check if the tid is invalid.
+    int ret_val;
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_quantums: unvalid tid " + std::to_string(tid), PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    else{
+        ret_val = thread_ptr->quantom_count; // Get the quantum count for the thread, wherever it is.
+    }
+    unlock_library();
+    leave_library(); // Leave the critical section after execution.
+    return ret_val;
+}
+
+
+int uthread_reserve_threads(int num_threads){
+    // Function flow: checking input, growing the pool by one slab so at least num_threads control blocks are free.
+    if(num_threads < 0){
+        print_error("uthread_reserve_threads: num_threads must be non-negative", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    lock_library();
+    if(thread_pool.available() < (size_t) num_threads){
+        thread_pool.grow(num_threads - thread_pool.available());
+    }
+    unlock_library();
+    leave_library();
+    return 0;
+}
+
+
+int uthread_yield(){
+    // Function flow: enter the critical section, moving the running thread to the end of the READY list and jumping to the next one (like a preemption).
+    enter_library();
+    preempt_running_thread(); // returns when this thread runs again
+    leave_library();
+    return 0;
+}
+
+
+int uthread_switch_to(int tid){
+    // Function flow: enter the critical section, checking tid, moving the running thread to the end of the READY list, and the wanted one to the front (running).
+    if(workers_unsupported("uthread_switch_to")){
+        return -1;
+    }
+    enter_library();
+    Thread* next = find_thread(tid);
+    if(next == nullptr || next->state == ThreadState::BLOCKED){
+        print_error("uthread_switch_to: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    Thread* prev_running = running_thread;
+    if(next != prev_running){
+        charge_running_thread();
+        ready_remove(next);
+        ready_push(prev_running);
+        running_thread = next;
+        pre_jumping(); // a new quantum starts for the wanted thread
+        uthreads_switch_context(&prev_running->env, &next->env); // returns when this thread runs again
+    }
+    leave_library();
     return 0;
 }
-int uthread_sleep(int num_quantums){
-    block_timer_signal(); // Block the timer signal to prevent interruptions.
-    if(unblocked_threads.front()->tid == 0){ // Ensure the main thread is not trying to sleep.
-        print_error("uthread_sleep: trying to put main thread to sleep", PrintType::THREAD_LIB_ERR);
+
+
+int uthread_set_sched_policy(int policy){
+    // Function flow: checking input, enter the critical section, moving the READY threads (in their order) to the queues of the new policy.
+    if(policy < UTHREAD_SCHED_RR || policy > UTHREAD_SCHED_STRIDE){
+        print_error("uthread_set_sched_policy: unknown policy", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    if(policy != UTHREAD_SCHED_RR && workers_unsupported("uthread_set_sched_policy")){
         return -1;
     }
-    Thread *prev_running = unblocked_threads.front();
-    prev_running-> wake_up_quantum = total_quantums + num_quantums - 1; // Set the wake-up quantum for the thread.
-    prev_running->sleeping = true; // Set the sleeping flag for the thread.
-    blocked_threads.push_back(prev_running); // Move the running thread to the blocked list.
-    unblocked_threads.pop_front(); // Remove the thread from the unblocked list.
-    if(sigsetjmp(prev_running->env, 1) == 0){ // Save the current thread's context.
-        pre_jumping(); // Perform actions before switching threads.
-        unblock_timer_signal(); // Unblock the timer signal before switching.
-        siglongjmp(unblocked_threads.front()->env, 1); // Switch to the next thread's context.
+    enter_library();
+    ThreadQueue moving;
+    while(ready_size() > 0){
+        moving.push_back(ready_pop());
+    }
+    if(policy == UTHREAD_SCHED_FAIR && sched_policy != UTHREAD_SCHED_FAIR){
+        fair_switch_ns = cpu_time_ns(); // the running thread is charged from now
     }
-    unblock_timer_signal(); // Unblock the timer signal after execution.
+    sched_policy = policy;
+    while(!moving.empty()){
+        make_ready(moving.pop_front());
+    }
+    leave_library();
     return 0;
 }
- 
-int uthread_get_tid(){
-    return unblocked_threads.front()->tid; // Return the ID of the currently running thread.
+
+
+int uthread_get_sched_policy(){
+    return sched_policy;
 }
-    
-int uthread_get_total_quantums(){
-    return total_quantums; // Return the total number of quantums since initialization.
+
+
+int uthread_set_priority(int tid, int priority){
+    // Function flow: checking input, enter the critical section, moving a READY thread to the queue of its new priority, and preempting the running thread if it is not the highest anymore.
+    if(workers_unsupported("uthread_set_priority")){
+        return -1;
+    }
+    if(priority < 0 || priority >= UTHREAD_PRIORITY_LEVELS){
+        print_error("uthread_set_priority: priority out of range", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr){
+        print_error("uthread_set_priority: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    if(thread_ptr->state == ThreadState::READY){
+        ready_remove(thread_ptr);
+        thread_ptr->priority = priority;
+        make_ready(thread_ptr);
+    }
+    else{
+        thread_ptr->priority = priority;
+        if(thread_ptr == running_thread && sched_policy == UTHREAD_SCHED_PRIORITY && !priority_threads.empty() &&
+           priority_threads.top_level() > priority){
+            preempt_pending = 1; // the running thread lowered itself below a READY thread
+        }
+    }
+    leave_library();
+    return 0;
 }
-    
-int uthread_get_quantums(int tid){
-    block_timer_signal(); // Block the timer signal to prevent interruptions.
-    bool unvalid_tid = unused_tid.find(tid) != unused_tid.end() || tid >= MAX_THREAD_NUM || tid < 0; // Check if the tid is invalid.
+
+
+int uthread_get_priority(int tid){
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
     int ret_val;
-    if(unvalid_tid){
-        print_error("uthread_get_quantums: unvalid tid " + std::to_string(tid), PrintType::THREAD_LIB_ERR);
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_priority: unvalid tid", PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    else{
+        ret_val = thread_ptr->priority;
+    }
+    leave_library();
+    return ret_val;
+}
+
+
+int uthread_get_mlfq_level(int tid){
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    int ret_val;
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_mlfq_level: unvalid tid", PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    else{
+        ret_val = mlfq_level(thread_ptr);
+    }
+    leave_library();
+    return ret_val;
+}
+
+
+int uthread_set_quantum(int tid, int quantum_usecs){
+    // Function flow: checking input, enter the critical section, updating the quantum length of the thread (used from its next quantum).
+    if(quantum_usecs < 0){
+        print_error("uthread_set_quantum: quantum_usecs must be non-negative", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    lock_library();
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr){
+        print_error("uthread_set_quantum: unvalid tid", PrintType::THREAD_LIB_ERR);
+        unlock_library();
+        leave_library();
+        return -1;
+    }
+    thread_ptr->quantum_usecs = quantum_usecs;
+    unlock_library();
+    leave_library();
+    return 0;
+}
+
+
+int uthread_get_quantum(int tid){
+    enter_library();
+    lock_library();
+    Thread* thread_ptr = find_thread(tid);
+    int ret_val;
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_quantum: unvalid tid", PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    else{
+        ret_val = thread_ptr->quantum_usecs != 0 ? thread_ptr->quantum_usecs : quantum_per_thread;
+    }
+    unlock_library();
+    leave_library();
+    return ret_val;
+}
+
+
+int uthread_set_weight(int tid, int weight){
+    // Function flow: checking input, enter the critical section, charging the running thread with its old weight, updating the weight.
+    if(workers_unsupported("uthread_set_weight")){
+        return -1;
+    }
+    if(weight <= 0){
+        print_error("uthread_set_weight: weight must be positive", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr){
+        print_error("uthread_set_weight: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    if(thread_ptr == running_thread){
+        fair_charge_running_thread(); // the CPU time until now is charged with the old weight
+    }
+    thread_ptr->weight = weight; // the vruntime doesn't change, so a READY thread keeps its place
+    leave_library();
+    return 0;
+}
+
+
+int uthread_get_weight(int tid){
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    int ret_val;
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_weight: unvalid tid", PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    else{
+        ret_val = thread_ptr->weight;
+    }
+    leave_library();
+    return ret_val;
+}
+
+
+long long uthread_get_vruntime(int tid){
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    long long ret_val;
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_vruntime: unvalid tid", PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    else{
+        if(thread_ptr == running_thread){
+            fair_charge_running_thread(); // up to date for the running thread as well
+        }
+        ret_val = thread_ptr->vruntime;
+    }
+    leave_library();
+    return ret_val;
+}
+
+
+int uthread_set_deadline(int tid, int period_quantums, int deadline_quantums){
+    // Function flow: checking input, enter the critical section, releasing the first job of the thread now (a READY thread moves to the queue of its new kind).
+    if(workers_unsupported("uthread_set_deadline")){
+        return -1;
+    }
+    if(period_quantums < 0 || (period_quantums > 0 && (deadline_quantums <= 0 || deadline_quantums > period_quantums))){
+        print_error("uthread_set_deadline: must have 0 < deadline_quantums <= period_quantums", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr || tid == 0){
+        print_error("uthread_set_deadline: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    bool ready = thread_ptr->state == ThreadState::READY;
+    if(ready){
+        ready_remove(thread_ptr);
+    }
+    thread_ptr->period = period_quantums;
+    thread_ptr->relative_deadline = deadline_quantums;
+    thread_ptr->absolute_deadline = total_quantums + deadline_quantums;
+    thread_ptr->next_release = total_quantums + period_quantums;
+    if(ready){
+        make_ready(thread_ptr);
+    }
+    leave_library();
+    return 0;
+}
+
+
+int uthread_wait_next_period(){
+    // Function flow: enter the critical section, counting a miss if the job is done late, sleeping until the release of the next job, and setting its deadline.
+    if(workers_unsupported("uthread_wait_next_period")){
+        return -1;
+    }
+    enter_library();
+    Thread* thread_ptr = running_thread;
+    if(thread_ptr->period == 0){
+        print_error("uthread_wait_next_period: the thread has no period", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    if(total_quantums > thread_ptr->absolute_deadline){
+        thread_ptr->deadline_misses++;
+    }
+    int release = thread_ptr->next_release;
+    thread_ptr->absolute_deadline = release + thread_ptr->relative_deadline;
+    thread_ptr->next_release = release + thread_ptr->period;
+    if(release > total_quantums){
+        sleep_running_thread(release); // returns in the quantum of the release
+    }
+    else if(sched_policy == UTHREAD_SCHED_EDF && !edf_threads.empty() && runs_before_edf(edf_threads.top(), thread_ptr)){
+        preempt_pending = 1; // the next job was already released (late), but another deadline is nearer
+    }
+    leave_library();
+    return 0;
+}
+
+
+int uthread_get_deadline_misses(int tid){
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    int ret_val;
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_deadline_misses: unvalid tid", PrintType::THREAD_LIB_ERR);
+        ret_val = -1;
+    }
+    else{
+        ret_val = thread_ptr->deadline_misses;
+    }
+    leave_library();
+    return ret_val;
+}
+
+
+int uthread_set_tickets(int tid, int tickets){
+    // Function flow: checking input, enter the critical section, scaling what is left of the current stride of the thread by the new one, so the change applies right away.
+    if(workers_unsupported("uthread_set_tickets")){
+        return -1;
+    }
+    if(tickets <= 0 || tickets > UTHREAD_TICKETS_MAX){
+        print_error("uthread_set_tickets: tickets out of range", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    if(thread_ptr == nullptr){
+        print_error("uthread_set_tickets: unvalid tid", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    bool ready = thread_ptr->state == ThreadState::READY;
+    if(ready){
+        ready_remove(thread_ptr);
+    }
+    long long stride = STRIDE_ONE / tickets;
+    long long remaining = thread_ptr->pass - stride_global_pass; // how far the thread is ahead of the scheduler
+    thread_ptr->pass = stride_global_pass + remaining * stride / thread_ptr->stride;
+    thread_ptr->tickets = tickets;
+    thread_ptr->stride = stride;
+    if(ready){
+        make_ready(thread_ptr);
+    }
+    leave_library();
+    return 0;
+}
+
+
+int uthread_get_tickets(int tid){
+    enter_library();
+    Thread* thread_ptr = find_thread(tid);
+    int ret_val;
+    if(thread_ptr == nullptr){
+        print_error("uthread_get_tickets: unvalid tid", PrintType::THREAD_LIB_ERR);
         ret_val = -1;
     }
     else{
-        auto unblocked_itr = find_thread_in_list(unblocked_threads, tid);
-        if(unblocked_itr != unblocked_threads.end()){
-            ret_val = (*unblocked_itr) -> quantom_count; // Get the quantum count for the thread in the unblocked list.
+        ret_val = thread_ptr->tickets;
+    }
+    leave_library();
+    return ret_val;
+}
+
+
+int uthread_set_tickless(int enable){
+    // Function flow: enter the critical section, updating the mode, and restarting the quantum of the running thread by the new mode.
+    if(workers_unsupported("uthread_set_tickless")){
+        return -1;
+    }
+    enter_library();
+    tickless = enable != 0;
+    start_timer();
+    leave_library();
+    return 0;
+}
+
+
+int uthread_set_timer_backend(int backend){
+    // Function flow: checking input, enter the critical section, stopping the current timer, creating the posix timer on the clock of the backend, restarting the quantum of the running thread on it.
+    if(workers_unsupported("uthread_set_timer_backend")){
+        return -1;
+    }
+    if(backend < UTHREAD_TIMER_ITIMER || backend > UTHREAD_TIMER_MONOTONIC){
+        print_error("uthread_set_timer_backend: unknown backend", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    stop_timer();
+    if(timer_backend != UTHREAD_TIMER_ITIMER){
+        timer_delete(posix_timer);
+    }
+    if(backend != UTHREAD_TIMER_ITIMER){
+        posix_timer_clock = backend == UTHREAD_TIMER_CPUTIME ? CLOCK_THREAD_CPUTIME_ID : CLOCK_MONOTONIC;
+        struct sigevent event = {};
+        event.sigev_notify = SIGEV_SIGNAL;
+        event.sigev_signo = SIGVTALRM; // the same sig-handler as the itimer
+        if(timer_create(posix_timer_clock, &event, &posix_timer) != 0){
+            print_error("uthread_set_timer_backend: timer_create failed", PrintType::SYSTEM_ERR); // this call will end the run with exit(1)
+        }
+    }
+    timer_backend = backend;
+    timer_fired = 0;
+    timer_expirations = timer_jitter_sum_ns = timer_jitter_max_ns = 0;
+    start_timer();
+    leave_library();
+    return 0;
+}
+
+
+int uthread_get_timer_stats(uthread_timer_stats_t* stats){
+    // Function flow: checking input, enter the critical section, copying the stats of the timer.
+    if(stats == nullptr){
+        print_error("uthread_get_timer_stats: null stats", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    stats->expirations = timer_expirations;
+    stats->mean_jitter_ns = timer_expirations > 0 ? timer_jitter_sum_ns / timer_expirations : 0;
+    stats->max_jitter_ns = timer_jitter_max_ns;
+    leave_library();
+    return 0;
+}
+
+
+int uthread_idle(){
+    // Function flow: enter the critical section. if no other thread is READY, stopping the timer and waiting (without the CPU) until the next sleeping thread
+    //                should wake up, or until a signal. the quantums that passed in the wait are counted, and then a new quantum starts like in uthread_yield.
+    enter_library();
+    if(workers == nullptr && ready_size() == 0){ // with workers, a worker waits in its idle loop when it has nothing to run
+        idle_wait();
+    }
+    preempt_running_thread(); // wakes up the sleeping threads that are due, returns when this thread runs again
+    leave_library();
+    return 0;
+}
+
+
+int uthread_mutex_init(uthread_mutex_t* mutex){
+    if(mutex == nullptr){
+        print_error("uthread_mutex_init: null mutex", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    *mutex = UTHREAD_MUTEX_INITIALIZER;
+    return 0;
+}
+
+
+int uthread_mutex_lock(uthread_mutex_t* mutex){
+    // Function flow: checking input, enter the critical section, taking an unlocked mutex with a single CAS. otherwise checking that the thread doesn't
+    //                hold it already, and waiting for it (mutex_lock_slow) until its owner hands it over.
+    if(mutex == nullptr){
+        print_error("uthread_mutex_lock: null mutex", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    int owner_state = mutex_owner_state(running_thread);
+    int state = 0;
+    if(!__atomic_compare_exchange_n(&mutex->state, &state, owner_state, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        if((state & ~MUTEX_WAITERS) == owner_state){
+            print_error("uthread_mutex_lock: the thread already holds the mutex", PrintType::THREAD_LIB_ERR);
+            leave_library();
+            return -1;
+        }
+        mutex_lock_slow(mutex, owner_state);
+    }
+    leave_library();
+    return 0;
+}
+
+
+int uthread_mutex_unlock(uthread_mutex_t* mutex){
+    // Function flow: checking input, enter the critical section, unlocking a mutex no thread waits for with a single CAS. otherwise checking that the
+    //                thread holds it, and handing it over to the first waiting thread (mutex_hand_over).
+    if(mutex == nullptr){
+        print_error("uthread_mutex_unlock: null mutex", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    int owner_state = mutex_owner_state(running_thread);
+    int state = owner_state;
+    if(!__atomic_compare_exchange_n(&mutex->state, &state, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+        if((state & ~MUTEX_WAITERS) != owner_state){
+            print_error("uthread_mutex_unlock: the thread doesn't hold the mutex", PrintType::THREAD_LIB_ERR);
+            leave_library();
+            return -1;
+        }
+        mutex_hand_over(mutex);
+    }
+    leave_library();
+    return 0;
+}
+
+
+int uthread_cond_init(uthread_cond_t* cond){
+    if(cond == nullptr){
+        print_error("uthread_cond_init: null cond", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    *cond = UTHREAD_COND_INITIALIZER;
+    return 0;
+}
+
+
+int uthread_cond_wait(uthread_cond_t* cond, uthread_mutex_t* mutex){
+    // Function flow: checking input, enter the critical section, checking that the thread holds the mutex, waiting in the wait queue of cond (the mutex
+    //                is unlocked once the thread is in the queue), and locking the mutex again after the thread is woken up.
+    if(cond == nullptr || mutex == nullptr){
+        print_error("uthread_cond_wait: null cond or mutex", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    int owner_state = mutex_owner_state(running_thread);
+    if((__atomic_load_n(&mutex->state, __ATOMIC_RELAXED) & ~MUTEX_WAITERS) != owner_state){
+        print_error("uthread_cond_wait: the thread doesn't hold the mutex", PrintType::THREAD_LIB_ERR);
+        leave_library();
+        return -1;
+    }
+    lock_wait_queue(&cond->waiters);
+    wait_in_queue(&cond->waiters, mutex); // returns after a signal or a broadcast
+    mutex_acquire(mutex, owner_state);
+    leave_library();
+    return 0;
+}
+
+
+int uthread_cond_signal(uthread_cond_t* cond){
+    // Function flow: checking input, enter the critical section, taking the first thread out of the wait queue of cond and making it READY.
+    if(cond == nullptr){
+        print_error("uthread_cond_signal: null cond", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    lock_wait_queue(&cond->waiters);
+    Thread* thread = take_waiter(&cond->waiters);
+    unlock_wait_queue(&cond->waiters);
+    if(thread != nullptr){
+        wake_waiter(thread);
+    }
+    leave_library();
+    return 0;
+}
+
+
+int uthread_cond_broadcast(uthread_cond_t* cond){
+    // Function flow: checking input, enter the critical section, making all the threads of the wait queue of cond READY together (wake_all_waiters).
+    if(cond == nullptr){
+        print_error("uthread_cond_broadcast: null cond", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    wake_all_waiters(&cond->waiters);
+    leave_library();
+    return 0;
+}
+
+
+int uthread_sem_init(uthread_sem_t* sem, int value){
+    if(sem == nullptr || value < 0){
+        print_error("uthread_sem_init: null sem or negative value", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    *sem = UTHREAD_SEM_INITIALIZER(value);
+    return 0;
+}
+
+
+int uthread_sem_wait(uthread_sem_t* sem){
+    // Function flow: checking input, enter the critical section, taking a permit with a CAS if there is one. otherwise looking again with the wait queue
+    //                locked (uthread_sem_post adds permits only with it locked when threads may wait), and waiting in it for the permit of a post.
+    if(sem == nullptr){
+        print_error("uthread_sem_wait: null sem", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    if(!sem_try_take(sem)){
+        lock_wait_queue(&sem->waiters);
+        if(sem_try_take(sem)){
+            unlock_wait_queue(&sem->waiters);
         }
         else{
-            auto blocked_itr = find_thread_in_list(blocked_threads, tid);
-            ret_val = (*blocked_itr) -> quantom_count; // Get the quantum count for the thread in the blocked list.
+            wait_in_queue(&sem->waiters, nullptr); // returns with the permit
         }
     }
-    unblock_timer_signal(); // Unblock the timer signal after execution.
-    return ret_val;
-}
\ No newline at end of file
+    leave_library();
+    return 0;
+}
+
+
+int uthread_sem_post(uthread_sem_t* sem){
+    // Function flow: checking input, enter the critical section, handing the permit to the first thread of the wait queue (and making it READY), or
+    //                adding it to the count if no thread waits.
+    if(sem == nullptr){
+        print_error("uthread_sem_post: null sem", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    enter_library();
+    lock_wait_queue(&sem->waiters);
+    Thread* thread = take_waiter(&sem->waiters);
+    if(thread == nullptr){
+        __atomic_fetch_add(&sem->count, 1, __ATOMIC_RELEASE);
+    }
+    unlock_wait_queue(&sem->waiters);
+    if(thread != nullptr){
+        wake_waiter(thread);
+    }
+    leave_library();
+    return 0;
+}
+
+
+int uthread_sem_getvalue(uthread_sem_t* sem){
+    if(sem == nullptr){
+        print_error("uthread_sem_getvalue: null sem", PrintType::THREAD_LIB_ERR);
+        return -1;
+    }
+    return __atomic_load_n(&sem->count, __ATOMIC_RELAXED);
+}
@@ -7,11 +7,96 @@
 #define _UTHREADS_H
 
 
+#include <stddef.h>
+
 #define MAX_THREAD_NUM 100 /* maximal number of threads */
 #define STACK_SIZE 4096 /* stack size per thread (in bytes) */
 
 typedef void (*thread_entry_point)(void);
 
+/* stack modes, for uthread_attr_t.stack_mode */
+#define UTHREAD_STACK_FIXED 0 /* a regular stack (default) */
+#define UTHREAD_STACK_LAZY 1  /* only reserved: pages are committed on first touch and given back when the thread ends */
+
+/* scheduling policies, for uthread_set_sched_policy */
+#define UTHREAD_SCHED_RR 0       /* round-robin over all the READY threads (default) */
+#define UTHREAD_SCHED_PRIORITY 1 /* round-robin over the READY threads of the highest priority */
+#define UTHREAD_SCHED_MLFQ 2     /* multi-level feedback queue: threads that use their whole quantum move down a level */
+#define UTHREAD_SCHED_FAIR 3     /* fair share: the thread that used the least CPU time (by its weight) runs next */
+#define UTHREAD_SCHED_EDF 4      /* earliest deadline first for the deadline threads, round-robin for the others */
+#define UTHREAD_SCHED_STRIDE 5   /* stride scheduling: every thread gets quantums in proportion to its tickets */
+
+/* thread priorities are in [0, UTHREAD_PRIORITY_LEVELS), higher runs first */
+#define UTHREAD_PRIORITY_LEVELS 32
+#define UTHREAD_PRIORITY_DEFAULT 16
+
+/* UTHREAD_SCHED_MLFQ levels are in [0, UTHREAD_MLFQ_LEVELS), 0 runs first. the quantum of level i is 2^i quantums long */
+#define UTHREAD_MLFQ_LEVELS 8
+#define UTHREAD_MLFQ_BOOST_QUANTUMS 50 /* every thread is moved back to level 0 once in this many quantums */
+
+/* UTHREAD_SCHED_FAIR weights: a thread gets CPU time in proportion to its weight */
+#define UTHREAD_WEIGHT_DEFAULT 1024
+
+/* UTHREAD_SCHED_STRIDE tickets are in [1, UTHREAD_TICKETS_MAX]: a thread gets quantums in proportion to its tickets */
+#define UTHREAD_TICKETS_DEFAULT 100
+#define UTHREAD_TICKETS_MAX (1 << 20)
+
+/* preemption timer backends, for uthread_set_timer_backend */
+#define UTHREAD_TIMER_ITIMER 0    /* setitimer(ITIMER_VIRTUAL): user CPU time of the process, coarse resolution (default) */
+#define UTHREAD_TIMER_CPUTIME 1   /* timer_create(CLOCK_THREAD_CPUTIME_ID): user and system CPU time of the thread */
+#define UTHREAD_TIMER_MONOTONIC 2 /* timer_create(CLOCK_MONOTONIC): wall-clock time, high resolution */
+
+/* uthread_init_workers starts at most UTHREAD_MAX_WORKERS workers: an affinity mask has a bit per worker */
+#define UTHREAD_MAX_WORKERS 64
+#define UTHREAD_AFFINITY_ALL (~0ULL) /* every worker (the default) */
+
+/* stats of the timer_create backends, from uthread_get_timer_stats */
+typedef struct {
+    long long expirations;    /* quantums that were ended by the timer */
+    long long mean_jitter_ns; /* mean delay from the expiry the timer was armed to until the library got the signal */
+    long long max_jitter_ns;  /* longest such delay */
+} uthread_timer_stats_t;
+
+/* the threads waiting on a synchronization primitive, oldest first. the fields are internal to the library. */
+typedef struct {
+    int lock;           /* with uthread_init_workers, a spinlock that guards the queue */
+    void *head, *tail;  /* the waiting threads, linked inside their control blocks */
+    size_t size;
+} uthread_wait_queue_t;
+
+/* a mutex: initialize with UTHREAD_MUTEX_INITIALIZER or uthread_mutex_init. the fields are internal to the library. */
+typedef struct {
+    int state;                    /* 0 when unlocked, otherwise the owner and whether threads wait for it */
+    uthread_wait_queue_t waiters;
+} uthread_mutex_t;
+
+#define UTHREAD_MUTEX_INITIALIZER {0, {0, NULL, NULL, 0}}
+
+/* a condition variable: initialize with UTHREAD_COND_INITIALIZER or uthread_cond_init. */
+typedef struct {
+    uthread_wait_queue_t waiters;
+} uthread_cond_t;
+
+#define UTHREAD_COND_INITIALIZER {{0, NULL, NULL, 0}}
+
+/* a counting semaphore: initialize with UTHREAD_SEM_INITIALIZER(value) or uthread_sem_init. */
+typedef struct {
+    int count;                    /* the permits left */
+    uthread_wait_queue_t waiters;
+} uthread_sem_t;
+
+#define UTHREAD_SEM_INITIALIZER(value) {(value), {0, NULL, NULL, 0}}
+
+/* attributes of a new thread, for uthread_spawn_ex. initialize with uthread_attr_init before setting fields. */
+typedef struct {
+    size_t stack_size; /* usable stack size in bytes (default STACK_SIZE) */
+    int stack_mode;    /* UTHREAD_STACK_FIXED or UTHREAD_STACK_LAZY (default UTHREAD_STACK_FIXED) */
+    int priority;      /* scheduling priority (default UTHREAD_PRIORITY_DEFAULT) */
+    int quantum_usecs; /* length of the quantums of the thread, 0 for the one given to uthread_init (default 0) */
+    int weight;        /* share of the CPU under UTHREAD_SCHED_FAIR (default UTHREAD_WEIGHT_DEFAULT) */
+    int tickets;       /* share of the quantums under UTHREAD_SCHED_STRIDE (default UTHREAD_TICKETS_DEFAULT) */
+} uthread_attr_t;
+
 /* External interface */
 
 /**
@@ -28,13 +113,93 @@ typedef void (*thread_entry_point)(void);
 */
 int uthread_init(int quantum_usecs);
 
+
+/**
+ * @brief initializes the thread library like uthread_init, with a limit of max_thread_num concurrent threads
+ * (including the main thread) instead of MAX_THREAD_NUM.
+ *
+ * Every library structure is sized by this limit, and every operation stays O(1) with respect to it (spawning may
+ * scan the tid bitmap, 64 tids per step), so it can be used with millions of threads.
+ * It is an error to call this function with non-positive quantum_usecs or max_thread_num. Only one of uthread_init and
+ * uthread_init_ex should be called.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_ex(int quantum_usecs, int max_thread_num);
+
+
+/**
+ * @brief initializes the thread library like uthread_init_ex, in M:N mode: the threads run on worker_count kernel
+ * threads (workers) instead of one, so they can use several cores. The calling kernel thread is worker 0.
+ *
+ * Every worker has its own deque of READY threads and its own preemption timer (on its CPU time). The new threads
+ * are spread over the workers round-robin, a preempted thread stays on its worker, and a resumed or woken up thread
+ * goes back to the worker it ran on (through a lock-free inbox, and a doorbell that wakes the worker up if it is
+ * idle). A worker with nothing of its own to run steals the oldest READY thread of another worker (Chase-Lev), and
+ * waits without the CPU when there is none.
+ * The API keeps its semantics, with these differences:
+ * - Only UTHREAD_SCHED_RR is supported, without uthread_switch_to, tickless mode or timer backends (the functions of
+ *   the other policies and features fail).
+ * - Blocking or terminating a thread that is READY, or that runs on another worker, takes effect when a worker takes
+ *   it off the CPU (right away for a running one, which is preempted). Until then its tid is not reused.
+ * - The quantums of all the workers are counted together by uthread_get_total_quantums (and by uthread_sleep).
+ * - Threads can move between workers, so they must not keep pointers to thread-local data of the kernel thread
+ *   (errno included) across a preemption point. uthread_terminate(0) ends the process with _exit, after fflush.
+ * Once in a few quantums, a worker that has at least two READY threads more than another one moves some of them to
+ * it (stealing only helps a worker that has nothing to run), keeping the affinity of the threads.
+ * It is an error to call this function with a worker_count that is not in [1, UTHREAD_MAX_WORKERS]. Only one of the
+ * init functions should be called.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_workers(int quantum_usecs, int max_thread_num, int worker_count);
+
+
+/**
+ * @brief Returns the worker that runs the calling thread (0 without uthread_init_workers).
+ *
+ * @return The index of the worker, in [0, worker_count).
+*/
+int uthread_get_worker();
+
+
+/**
+ * @brief Sets the workers the thread with ID tid may run on: bit i of worker_mask is worker i (UTHREAD_AFFINITY_ALL
+ * for all of them, the default). The bits of workers that don't exist are ignored.
+ *
+ * A thread that is restricted to some of the workers is never stolen, and moves only between the workers of its mask
+ * (by the load balancer). If the thread runs on a worker that is not in the mask it is preempted, and a READY one
+ * moves when a worker takes it. Without uthread_init_workers there is only worker 0, and the mask must include it.
+ * It is an error to call this function with a mask without any existing worker, or with a tid that doesn't exist.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_affinity(int tid, unsigned long long worker_mask);
+
+
+/**
+ * @brief Returns the workers the thread with ID tid may run on (of the existing workers).
+ *
+ * @return On success, return the mask. On failure (a tid that doesn't exist), return 0.
+*/
+unsigned long long uthread_get_affinity(int tid);
+
+
+/**
+ * @brief Returns the number of READY threads of the given worker (not counting the thread it runs), to watch the
+ * balance between the workers. It is a snapshot: other workers change it while it is read.
+ *
+ * @return On success, return the number of threads. On failure (a worker that doesn't exist), return -1.
+*/
+int uthread_get_worker_queue_length(int worker);
+
 /**
  * @brief Creates a new thread, whose entry point is the function entry_point with the signature
  * void entry_point(void).
  *
  * The thread is added to the end of the READY threads list.
  * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
- * limit (MAX_THREAD_NUM).
+ * limit (MAX_THREAD_NUM, or the one given to uthread_init_ex).
  * Each thread should be allocated with a stack of size STACK_SIZE bytes.
  * It is an error to call this function with a null entry_point.
  *
@@ -43,6 +208,35 @@ int uthread_init(int quantum_usecs);
 int uthread_spawn(thread_entry_point entry_point);
 
 
+/**
+ * @brief Sets the attributes to their defaults (the ones uthread_spawn uses).
+ *
+ * @return On success, return 0. On failure (a null attr), return -1.
+*/
+int uthread_attr_init(uthread_attr_t *attr);
+
+
+/**
+ * @brief Creates a new thread like uthread_spawn, with the given attributes.
+ *
+ * The stack is allocated with stack_size usable bytes at least (rounded up to a power of two pages, with extra room
+ * for the signal frame of a preemption), and with an inaccessible guard page below it, so a stack overflow crashes
+ * with SIGSEGV instead of corrupting other memory. Stacks of terminated threads are cached and reused by later spawns.
+ * With stack_mode UTHREAD_STACK_LAZY the stack is only reserved (MAP_NORESERVE), so a large stack_size costs physical
+ * memory only for the pages the thread actually touches, and these pages are given back (MADV_DONTNEED) when the thread
+ * terminates. This allows many mostly-idle threads with generous stacks. Lazy stacks are carved out of large shared
+ * reservations, and where the kernel supports guard regions (Linux 6.13 and up) their guard pages don't add mappings,
+ * so the number of lazy threads isn't bounded by the system's vm.max_map_count. A stack of the other mode is a
+ * separate mapping plus its guard page.
+ * A null attr means the default attributes. It is an error to call this function with a null entry_point, a zero
+ * stack_size, a stack_size above the largest stack the library allocates or an unknown stack_mode. Failing to allocate
+ * the stack is an error as well.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_ex(thread_entry_point entry_point, const uthread_attr_t *attr);
+
+
 /**
  * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
  *
@@ -95,6 +289,29 @@ int uthread_resume(int tid);
 int uthread_sleep(int num_quantums);
 
 
+/**
+ * @brief Gives up the CPU: the RUNNING thread moves to the end of the READY queue and a scheduling decision is made.
+ *
+ * This counts as the start of a new quantum, exactly like a preemption by the timer. If no other thread is READY, the
+ * calling thread keeps running in the new quantum.
+ *
+ * @return 0.
+*/
+int uthread_yield();
+
+
+/**
+ * @brief Hands the CPU directly to the READY thread with ID tid, without waiting for its turn in the READY queue.
+ *
+ * The calling thread moves to the end of the READY queue, and the order of the other READY threads does not change.
+ * This counts as the start of a new quantum, of the thread with ID tid. Switching to the calling thread itself has no
+ * effect. It is an error if no thread with ID tid exists or if it is BLOCKED (or sleeping).
+ *
+ * @return On success, return 0 (once the calling thread runs again). On failure, return -1.
+*/
+int uthread_switch_to(int tid);
+
+
 /**
  * @brief Returns the thread ID of the calling thread.
  *
@@ -126,4 +343,359 @@ int uthread_get_total_quantums();
 int uthread_get_quantums(int tid);
 
 
+/**
+ * @brief Pre-allocates thread control blocks, so the next num_threads calls to uthread_spawn do not use the heap.
+ *
+ * uthread_init allocates a small pool of control blocks, and the pool grows by itself when it runs out. Terminated
+ * threads return their control block to the pool. Call this function to pre-warm the pool before a burst of spawns.
+ * It is an error to call this function with a negative num_threads.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_reserve_threads(int num_threads);
+
+
+/**
+ * @brief Sets the scheduling policy: UTHREAD_SCHED_RR (the default), UTHREAD_SCHED_PRIORITY, UTHREAD_SCHED_MLFQ,
+ * UTHREAD_SCHED_FAIR, UTHREAD_SCHED_EDF or UTHREAD_SCHED_STRIDE. It is an error to call this function with any other
+ * policy.
+ *
+ * Under UTHREAD_SCHED_PRIORITY, a thread only runs when no thread of a higher priority is READY, and the threads of the
+ * same priority share the CPU round-robin. A thread that becomes READY with a higher priority than the RUNNING thread
+ * preempts it right away (this starts a new quantum). Under UTHREAD_SCHED_RR the priorities are kept but ignored.
+ *
+ * Under UTHREAD_SCHED_MLFQ, every thread has a level of its own (level 0 first, and a new thread starts there), read
+ * with uthread_get_mlfq_level. It is separate from the priority of uthread_set_priority, which this policy ignores.
+ * The quantum of a thread is 2^level times its own quantum (see uthread_set_quantum; by default the quantum given to
+ * uthread_init). A thread that uses its whole quantum moves down a level, and a thread that blocks or sleeps before
+ * its quantum ends moves up one (yielding keeps the level). Every UTHREAD_MLFQ_BOOST_QUANTUMS quantums all the threads
+ * move back to level 0, so none of them starves.
+ *
+ * Under UTHREAD_SCHED_FAIR, every thread is charged with the CPU time it actually used, divided by its weight (its
+ * vruntime), and the READY thread with the smallest vruntime runs next. So over time the threads that compete for the
+ * CPU get it in proportion to their weights, whether they use their whole quanta or not. A thread that becomes READY
+ * after being away gets at most half a quantum of credit over the others.
+ *
+ * Under UTHREAD_SCHED_EDF, the READY thread with the nearest deadline (see uthread_set_deadline) runs next, and a
+ * deadline thread that becomes READY preempts the RUNNING thread if its deadline is nearer. The threads without a
+ * deadline share the CPU round-robin, only when no deadline thread is READY.
+ *
+ * Under UTHREAD_SCHED_STRIDE, every thread has a pass that grows by a stride (inversely proportional to its tickets)
+ * for every quantum it runs, and the READY thread with the lowest pass runs next. So the threads that compete for the
+ * CPU get quantums in proportion to their tickets, deterministically (unlike a lottery). A thread that becomes READY
+ * after being away gets no credit for it.
+ *
+ * The READY threads keep their order when the policy changes.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_sched_policy(int policy);
+
+
+/**
+ * @brief Returns the current scheduling policy.
+*/
+int uthread_get_sched_policy();
+
+
+/**
+ * @brief Sets the priority of the thread with ID tid, in [0, UTHREAD_PRIORITY_LEVELS).
+ *
+ * A READY thread moves to the end of the queue of its new priority. If the RUNNING thread is not of the highest
+ * priority anymore, it is preempted right away.
+ * It is an error if no thread with ID tid exists or if priority is out of range.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_priority(int tid, int priority);
+
+
+/**
+ * @brief Returns the priority of the thread with ID tid.
+ *
+ * @return On success, return the priority. On failure, return -1.
+*/
+int uthread_get_priority(int tid);
+
+
+/**
+ * @brief Returns the UTHREAD_SCHED_MLFQ level of the thread with ID tid (it is only changed under UTHREAD_SCHED_MLFQ).
+ *
+ * @return On success, return the level. On failure, return -1.
+*/
+int uthread_get_mlfq_level(int tid);
+
+
+/**
+ * @brief Sets the length of the quantums of the thread with ID tid, in micro-seconds. 0 sets it back to the quantum
+ * given to uthread_init.
+ *
+ * The new length is used from the next quantum of the thread (the current quantum of the RUNNING thread is not
+ * changed). Under UTHREAD_SCHED_MLFQ it is the length of level 0, and it doubles with every level.
+ * It is an error if no thread with ID tid exists or if quantum_usecs is negative.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_quantum(int tid, int quantum_usecs);
+
+
+/**
+ * @brief Returns the length of the quantums of the thread with ID tid, in micro-seconds.
+ *
+ * @return On success, return the quantum length. On failure, return -1.
+*/
+int uthread_get_quantum(int tid);
+
+
+/**
+ * @brief Sets the UTHREAD_SCHED_FAIR weight of the thread with ID tid. The CPU time it uses from now on is charged by
+ * the new weight.
+ *
+ * It is an error if no thread with ID tid exists or if weight is not positive.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_weight(int tid, int weight);
+
+
+/**
+ * @brief Returns the UTHREAD_SCHED_FAIR weight of the thread with ID tid.
+ *
+ * @return On success, return the weight. On failure, return -1.
+*/
+int uthread_get_weight(int tid);
+
+
+/**
+ * @brief Returns the virtual runtime of the thread with ID tid: the nano-seconds of CPU time it used under
+ * UTHREAD_SCHED_FAIR, scaled by UTHREAD_WEIGHT_DEFAULT / weight (and moved forward when it becomes READY).
+ *
+ * @return On success, return the virtual runtime. On failure, return -1.
+*/
+long long uthread_get_vruntime(int tid);
+
+
+/**
+ * @brief Makes the thread with ID tid a periodic deadline thread: it runs a job every period_quantums quantums, and
+ * every job should be done within deadline_quantums quantums of its release. The first job is released now.
+ * A period_quantums of 0 makes it a regular thread again.
+ *
+ * Quantums are counted like in uthread_get_total_quantums. The deadlines order the threads under UTHREAD_SCHED_EDF,
+ * and the periods and the misses are kept under every policy.
+ * It is an error if no thread with ID tid exists, if tid == 0 (the main thread can't sleep between jobs), or if
+ * deadline_quantums is not in [1, period_quantums].
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_deadline(int tid, int period_quantums, int deadline_quantums);
+
+
+/**
+ * @brief Ends the current job of the calling deadline thread, and sleeps until the next job is released.
+ *
+ * A job that is done after its deadline is counted as a miss. If the next job was already released (the thread is
+ * late), the thread continues right away.
+ * It is an error to call this function from a thread without a period.
+ *
+ * @return On success, return 0 (when the next job starts). On failure, return -1.
+*/
+int uthread_wait_next_period();
+
+
+/**
+ * @brief Returns the number of jobs of the thread with ID tid that were done after their deadline.
+ *
+ * @return On success, return the number of misses. On failure, return -1.
+*/
+int uthread_get_deadline_misses(int tid);
+
+
+/**
+ * @brief Sets the UTHREAD_SCHED_STRIDE tickets of the thread with ID tid, in [1, UTHREAD_TICKETS_MAX].
+ *
+ * The change applies right away: what is left of the current stride of the thread is scaled to the new stride.
+ * It is an error if no thread with ID tid exists or if tickets is out of range.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_tickets(int tid, int tickets);
+
+
+/**
+ * @brief Returns the UTHREAD_SCHED_STRIDE tickets of the thread with ID tid.
+ *
+ * @return On success, return the number of tickets. On failure, return -1.
+*/
+int uthread_get_tickets(int tid);
+
+
+/**
+ * @brief Turns the tickless mode on (enable != 0) or off (the default).
+ *
+ * In tickless mode, the timer is stopped while the RUNNING thread is the only thread that can run and no thread is
+ * sleeping, so a long phase with a single thread runs without any signal or timer syscall, and no quantums pass.
+ * The quantum of the RUNNING thread starts again as soon as another thread becomes READY (spawned, resumed, or woken
+ * up). Either way, the quantum of the RUNNING thread restarts when the mode is set.
+ * It is an error to call this function after uthread_init_workers (tickless mode is not supported with workers).
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_tickless(int enable);
+
+
+/**
+ * @brief Sets the timer that ends the quantums: UTHREAD_TIMER_ITIMER (the default), UTHREAD_TIMER_CPUTIME or
+ * UTHREAD_TIMER_MONOTONIC.
+ *
+ * The timer_create backends are re-armed to absolute expiries: a quantum that was ended by the timer is measured from
+ * the expiry, and not from the moment the signal was handled, so the quanta don't drift. UTHREAD_TIMER_MONOTONIC has
+ * the resolution of the high-resolution timers, for quanta of tens of micro-seconds, but it counts wall-clock time
+ * (also while the process does not run). The quantum of the RUNNING thread restarts on the new timer, and the stats
+ * of uthread_get_timer_stats are cleared.
+ * It is an error to call this function with an unknown backend.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_timer_backend(int backend);
+
+
+/**
+ * @brief Fills stats with the expirations and the jitter of the timer since it was set with uthread_set_timer_backend.
+ * They are only measured by the timer_create backends (all zeros for UTHREAD_TIMER_ITIMER).
+ *
+ * @return On success, return 0. On failure (a null stats), return -1.
+*/
+int uthread_get_timer_stats(uthread_timer_stats_t *stats);
+
+
+/**
+ * @brief Gives up the CPU until another thread can run, instead of spinning in a busy loop (typically the main thread,
+ * while all the others are sleeping or blocked).
+ *
+ * If another thread is READY, this is like uthread_yield. Otherwise the process waits without using the CPU and
+ * without the timer: until the first sleeping thread should wake up, counting the quantums in wall-clock time
+ * (the quantum given to uthread_init each), or until a signal is handled if no thread is sleeping. Then a new quantum
+ * starts like in uthread_yield. The function may return before another thread ran (after a signal, for example), so
+ * it is usually called in a loop that checks for the work the caller waits for.
+ *
+ * @return 0.
+*/
+int uthread_idle();
+
+
+/**
+ * @brief Initializes the mutex as unlocked (like UTHREAD_MUTEX_INITIALIZER).
+ *
+ * @return On success, return 0. On failure (a null mutex), return -1.
+*/
+int uthread_mutex_init(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Locks the mutex, waiting until it is unlocked if another thread holds it.
+ *
+ * Taking an unlocked mutex is a single atomic operation. Otherwise the thread waits in the wait queue of the mutex
+ * (with workers, after spinning a little, since the owner may unlock it soon on another worker), and gets the mutex
+ * directly from uthread_mutex_unlock, in the order of arrival: the mutex is never free in between, so the woken up
+ * thread doesn't have to race the others for it. A waiting thread is BLOCKED: uthread_resume doesn't wake it up, and
+ * if uthread_block blocks it, it gets the mutex but stays blocked until it is resumed.
+ * It is an error to call this function with a null mutex, or with one the calling thread already holds.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_lock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Unlocks the mutex. If threads wait for it, the first of them becomes its owner and READY.
+ *
+ * Unlocking a mutex no thread waits for is a single atomic operation.
+ * It is an error to call this function with a null mutex, or with one the calling thread doesn't hold.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_unlock(uthread_mutex_t *mutex);
+
+/**
+ * @brief Initializes the condition variable, without waiting threads (like UTHREAD_COND_INITIALIZER).
+ *
+ * @return On success, return 0. On failure (a null cond), return -1.
+*/
+int uthread_cond_init(uthread_cond_t *cond);
+
+
+/**
+ * @brief Unlocks the mutex and waits on the condition variable, as one step: a signal after the mutex is unlocked is
+ * not missed. The mutex is locked again before the function returns.
+ *
+ * The thread waits in the wait queue of the condition variable (BLOCKED, like in uthread_mutex_lock: uthread_resume
+ * doesn't wake it up), until uthread_cond_signal or uthread_cond_broadcast. As with any condition variable, the
+ * condition should be checked again after it returns.
+ * It is an error to call this function with a null cond or mutex, or with a mutex the calling thread doesn't hold.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Wakes up the thread that waits the longest on the condition variable, if any, in O(1).
+ *
+ * @return On success, return 0. On failure (a null cond), return -1.
+*/
+int uthread_cond_signal(uthread_cond_t *cond);
+
+
+/**
+ * @brief Wakes up all the threads that wait on the condition variable.
+ *
+ * Without workers, the whole wait queue is taken at once, and under UTHREAD_SCHED_RR it is spliced onto the end of the
+ * READY queue in one operation, in the order the threads waited. With workers, the threads are taken in small batches
+ * (at most the ones that waited when the broadcast started), and every thread goes back to its worker.
+ *
+ * @return On success, return 0. On failure (a null cond), return -1.
+*/
+int uthread_cond_broadcast(uthread_cond_t *cond);
+
+
+/**
+ * @brief Initializes the semaphore with the given number of permits, without waiting threads.
+ *
+ * It is an error to call this function with a null sem or a negative value.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sem_init(uthread_sem_t *sem, int value);
+
+
+/**
+ * @brief Takes a permit of the semaphore, waiting for one if there is none.
+ *
+ * Taking an available permit is a single atomic operation. Otherwise the thread waits in the wait queue of the
+ * semaphore (BLOCKED, like in uthread_mutex_lock), and gets the permit of a uthread_sem_post directly, in the order
+ * of arrival.
+ * It is an error to call this function with a null sem.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sem_wait(uthread_sem_t *sem);
+
+
+/**
+ * @brief Gives back a permit to the semaphore: to the thread that waits the longest, if any, in O(1).
+ *
+ * It is an error to call this function with a null sem.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sem_post(uthread_sem_t *sem);
+
+
+/**
+ * @brief Returns the number of permits of the semaphore (a snapshot).
+ *
+ * @return On success, return the number of permits. On failure (a null sem), return -1.
+*/
+int uthread_sem_getvalue(uthread_sem_t *sem);
+
 #endif